@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <luisa/luisa-compute.h>
+#include "complex.hpp"
+#include "float6.hpp"
+#include "frame_encoder.hpp"
+#include "mandelbrot_6d.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* 余弦调色板 offset + amplitude * cos(2π(frequency * t + phase)), t = 连续迭代次数 / cycle
+ * 作为着色kernel的参数, 改颜色不需要重新编译
+ */
+struct cosine_palette {
+    float3 offset;
+    float3 amplitude;
+    float3 frequency;
+    float3 phase;
+    float cycle;     // 调色板重复一次对应的迭代次数
+    float trap_glow; // 内部点按exp(-trap_glow * trap)的灰度着色
+    float edge_width; // 到边界的距离估计小于这么多像素时逃逸点逐渐变暗, 0不画边界
+};
+
+LUISA_STRUCT(cosine_palette, offset, amplitude, frequency, phase, cycle, trap_glow, edge_width) {};
+using CosinePalette = Var<cosine_palette>;
+
+/* 逐像素的AOV(迭代次数和轨道信息)输出: 渲染时只写这些原始数据, 颜色由单独的着色kernel算,
+ * 改调色板只需要重新跑着色kernel, 不用重新迭代. 每帧存成一个多通道的浮点EXR
+ * 缓冲区按通道分开存放: 通道c的像素i在c * pixel_cnt + i
+ */
+namespace aov {
+// 通道顺序就是EXR里的顺序, 按名字的字母序
+enum Channel : uint {
+    kDerivative = 0, // |dz/dc|
+    kDistance,       // 到集合边界的距离估计, 单位是像素, 内部点为0
+    kSmooth,         // 连续的迭代次数, 内部点为max_iterations
+    kTrap,           // 轨道上|z|的最小值
+    kZImag,          // 最后的z
+    kZReal,
+    kChannels
+};
+
+constexpr std::array<const char*, kChannels> kChannelNames{"derivative", "distance", "smooth", "trap", "z.im", "z.re"};
+
+constexpr float kEscapeRadiusSquare = 1000.F; // 和mandelbrot_6d::iterate的逃逸条件相同
+constexpr float kMinDegree = 1.01F;           // |X|接近1时平滑公式发散, 按这个下限算
+
+// 一帧AOV缓冲区的float个数
+[[nodiscard]] constexpr size_t frame_floats(size_t width, size_t height) { return width * height * kChannels; }
+
+// 通道channel里第pixel_idx个像素在缓冲区里的下标. DSL的运算符不接受枚举, 先转成uint
+[[nodiscard]] inline UInt channel_index(Channel channel, const UInt& pixel_idx, const UInt& pixel_cnt) {
+    return static_cast<uint>(channel) * pixel_cnt + pixel_idx;
+}
+
+/* 在kernel里调用, 写一个像素的全部通道
+ * 连续迭代次数: n - log_|X|(ln|z - z_0|^2 / ln R^2), 逃逸时|z - z_0|^2刚越过R^2, 结果在[n - 1, n)附近连续变化
+ * c_pixel_size见mandelbrot_6d::c_pixel_size, 把距离估计换算成像素
+ */
+inline void store(
+    const BufferFloat& aovs, const UInt& pixel_idx, const UInt& pixel_cnt, const Float6& pos,
+    const mandelbrot_6d::Orbit& orbit, const UInt& max_iterations, const Float& c_pixel_size
+) {
+    Complex original_z{pos.first.x, pos.first.y};
+    Complex mb_x{pos.first.z, pos.second.x};
+    Float smooth = orbit.iterations_cnt.cast<float>();
+    if_(orbit.iterations_cnt < max_iterations, [&] {
+        Float escape_ratio = log((orbit.z - original_z)->abs_square()) / std::log(kEscapeRadiusSquare);
+        Float degree = max(sqrt(mb_x->abs_square()), kMinDegree);
+        smooth -= log(max(escape_ratio, 1.F)) / log(degree);
+    });
+    aovs.write(channel_index(kDerivative, pixel_idx, pixel_cnt), sqrt(orbit.derivative->abs_square()));
+    aovs.write(channel_index(kDistance, pixel_idx, pixel_cnt), mandelbrot_6d::distance_estimate(orbit, max_iterations) / c_pixel_size);
+    aovs.write(channel_index(kSmooth, pixel_idx, pixel_cnt), smooth);
+    aovs.write(channel_index(kTrap, pixel_idx, pixel_cnt), sqrt(orbit.trap_square));
+    aovs.write(channel_index(kZImag, pixel_idx, pixel_cnt), orbit.z.imag);
+    aovs.write(channel_index(kZReal, pixel_idx, pixel_cnt), orbit.z.real);
+}
+
+[[nodiscard]] inline cosine_palette default_palette() {
+    return cosine_palette{
+        make_float3(.5F), make_float3(.5F), make_float3(1.F), make_float3(0.F, .1F, .2F), 64.F, 4.F, 1.F
+    };
+}
+
+// 在着色kernel里调用, 只读smooth, trap和distance三个通道
+[[nodiscard]] inline Float4 shade(
+    const BufferFloat& aovs, const UInt& pixel_idx, const UInt& pixel_cnt, const Float& max_iterations,
+    const CosinePalette& palette
+) {
+    Float smooth = aovs.read(channel_index(kSmooth, pixel_idx, pixel_cnt));
+    Float4 color;
+    if_(smooth >= max_iterations, [&] {
+        Float trap = aovs.read(channel_index(kTrap, pixel_idx, pixel_cnt));
+        color = make_float4(make_float3(exp(-palette.trap_glow * trap)), 1.F);
+    }).else_([&] {
+        Float phase = smooth / palette.cycle;
+        Float3 rgb = palette.offset + palette.amplitude * cos(6.2831853F * (palette.frequency * phase + palette.phase));
+        if_(palette.edge_width > 0.F, [&] {
+            Float distance = aovs.read(channel_index(kDistance, pixel_idx, pixel_cnt));
+            rgb *= smoothstep(0.F, palette.edge_width, distance);
+        });
+        color = make_float4(clamp(rgb, 0.F, 1.F), 1.F);
+    });
+    return color;
+}
+
+// 读一帧AOV文件到按通道分开存放的数组, 尺寸不符或者缺通道时返回false
+[[nodiscard]] inline bool load(
+    const std::filesystem::path& file, std::uint32_t width, std::uint32_t height, std::vector<float>& planar
+) {
+    return frame_encoder::read_exr_channels(
+        file, static_cast<int>(width), static_cast<int>(height), kChannelNames, planar
+    );
+}
+}  // namespace aov
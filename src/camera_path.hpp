@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "float6.hpp"
+#include "ga_batch.hpp"
+#include "vga6.hpp"
+
+/* 动画的相机路径: 由种子生成若干关键帧旋量, 在关键帧之间做平滑插值,
+ * 一次性(并行)算出每一帧的变换矩阵, 渲染循环里只需要按帧号取. 算好的路径可以存成二进制文件, 重新渲染时直接读
+ */
+namespace camera_path {
+// 决定一条路径的全部参数, 种子相同时路径逐位相同
+struct Settings {
+    std::uint64_t seed = 0;
+    std::uint32_t keyframes = 4;  // 关键帧个数, 至少2个
+    std::uint32_t frames = 1000;  // 总帧数
+    float scale = 10.F;           // 旋转之后的缩放系数
+
+    bool operator==(const Settings&) const = default;
+};
+
+struct CameraPath {
+    Settings settings;
+    float6 translate{};                // 旋转缩放之后的平移
+    std::vector<float6x6> transforms;  // 每帧的旋转矩阵, 已经乘过scale
+};
+
+// 用gen依次生成count个随机旋量作为关键帧
+template <typename Generator>
+[[nodiscard]] std::vector<vga6::ga_type> random_keyframes(Generator& gen, size_t count) {
+    std::vector<vga6::ga_type> keyframes(count);
+    for (vga6::ga_type& rotor : keyframes) { rotor = vga6::random_rotor(gen); }
+    return keyframes;
+}
+
+/* 经过所有关键帧的旋量样条, 每段是用rotor_lerp做de Casteljau的三次Bezier曲线
+ * 关键帧k处的切向量(二重向量)取相邻两段相对旋量对数的平均(Catmull-Rom), 控制点是exp(±T_k / 3)乘上关键帧,
+ * 所以经过关键帧时速度连续. 只有两个关键帧时控制点都在测地线上, 就是原来的rotor_lerp(start, end, t)
+ */
+class RotorSpline {
+public:
+    explicit RotorSpline(std::span<const vga6::ga_type> keyframes) {
+        const size_t count = keyframes.size();
+        // 相邻关键帧的相对旋量的对数: log(R_{k+1} ~R_k)
+        std::vector<vga6::bivector_type> logs(count - 1);
+        for (size_t seg = 0; seg + 1 < count; ++seg) {
+            const vga6::ga_type relative = ga_expr::lazy(keyframes[seg + 1]) * ga_expr::lazy(keyframes[seg]).reverse()
+                * (1. / keyframes[seg].norm_squared());
+            logs[seg] = vga6::rotor_log(vga6::rotor_type{relative});
+        }
+        std::vector<vga6::bivector_type> tangents(count);
+        for (size_t key = 0; key < count; ++key) {
+            if (key == 0) {
+                tangents[key] = logs.front();
+            } else if (key + 1 == count) {
+                tangents[key] = logs.back();
+            } else {
+                tangents[key] = (logs[key - 1] + logs[key]) * 0.5;
+            }
+        }
+
+        controls_.reserve(count - 1);
+        for (size_t seg = 0; seg + 1 < count; ++seg) {
+            controls_.push_back({
+                keyframes[seg],
+                vga6::bivector_exp(tangents[seg] * (1. / 3.)).to_full() * keyframes[seg],
+                vga6::bivector_exp(tangents[seg + 1] * (-1. / 3.)).to_full() * keyframes[seg + 1],
+                keyframes[seg + 1]
+            });
+        }
+    }
+
+    // t在[0, 1]上均匀地走过所有段
+    [[nodiscard]] vga6::ga_type at(double t_val) const {
+        const double pos = std::clamp(t_val, 0., 1.) * static_cast<double>(controls_.size());
+        const size_t seg = std::min(static_cast<size_t>(pos), controls_.size() - 1);
+        const double local = pos - static_cast<double>(seg);
+
+        std::array<vga6::ga_type, 4> points = controls_[seg];
+        for (size_t level = 3; level > 0; --level) {
+            for (size_t idx = 0; idx < level; ++idx) { points[idx] = vga6::rotor_lerp(points[idx], points[idx + 1], local); }
+        }
+        return points[0];
+    }
+
+private:
+    std::vector<std::array<vga6::ga_type, 4>> controls_;  // 每段的4个控制点
+};
+
+// 第frame帧在样条上的参数, 可以不是整数(帧之间的时刻)
+[[nodiscard]] inline double frame_t(const Settings& settings, double frame) {
+    return frame / std::max<double>(1., static_cast<double>(settings.frames) - 1.);
+}
+
+// settings对应的样条, 和make_camera_path用的相同: 关键帧是种子生成的第一批随机数
+[[nodiscard]] inline RotorSpline make_spline(const Settings& settings) {
+    std::mt19937_64 gen(settings.seed);
+    return RotorSpline(random_keyframes(gen, std::max<size_t>(2, settings.keyframes)));
+}
+
+// 按settings生成路径. 关键帧和平移都来自同一个种子; 每帧的插值互不依赖, 分给多个线程
+[[nodiscard]] inline CameraPath make_camera_path(const Settings& settings) {
+    std::mt19937_64 gen(settings.seed);
+    const std::vector<vga6::ga_type> keyframes = random_keyframes(gen, std::max<size_t>(2, settings.keyframes));
+    std::uniform_real_distribution<float> distribution(-1, .1);
+
+    CameraPath path;
+    path.settings = settings;
+    path.translate = make_float6(
+        #define R distribution(gen) * 2.F
+        R, R, R, R, R, R
+        #undef R
+    );
+    path.transforms.resize(settings.frames);
+
+    const RotorSpline spline(keyframes);
+    ga_batch::parallel_for(settings.frames, 8, [&](size_t begin, size_t end) {
+        for (size_t frame = begin; frame < end; ++frame) {
+            path.transforms[frame] = vga6::rotor_to_matrix(spline.at(frame_t(settings, static_cast<double>(frame))), settings.scale);
+        }
+    });
+    return path;
+}
+
+namespace detail {
+constexpr std::array<char, 8> kMagic{'i', 'L', 'C', 'G', 'p', 'a', 't', 'h'};
+constexpr std::uint32_t kVersion = 1;
+
+// float3按16字节对齐, 直接写结构体会带上填充, 所以逐个分量读写
+inline void write_float6(std::ofstream& out, const float6& val) {
+    const std::array<float, 6> values{val.first.x, val.first.y, val.first.z, val.second.x, val.second.y, val.second.z};
+    out.write(reinterpret_cast<const char*>(values.data()), sizeof(values));
+}
+
+inline bool read_float6(std::ifstream& in, float6& val) {
+    std::array<float, 6> values{};
+    if (!in.read(reinterpret_cast<char*>(values.data()), sizeof(values))) { return false; }
+    val = make_float6(values[0], values[1], values[2], values[3], values[4], values[5]);
+    return true;
+}
+
+template <typename Value>
+void write_value(std::ofstream& out, const Value& val) {
+    out.write(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+template <typename Value>
+bool read_value(std::ifstream& in, Value& val) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&val), sizeof(val)));
+}
+}  // namespace detail
+
+/* 二进制格式(本机字节序): 魔数, 版本, Settings的各个字段, 平移, 然后每帧6列, 每列6个float
+ * 写失败时返回false
+ */
+inline bool save(const CameraPath& path, const std::filesystem::path& file) {
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) { return false; }
+    out.write(detail::kMagic.data(), detail::kMagic.size());
+    detail::write_value(out, detail::kVersion);
+    detail::write_value(out, path.settings.seed);
+    detail::write_value(out, path.settings.keyframes);
+    detail::write_value(out, path.settings.frames);
+    detail::write_value(out, path.settings.scale);
+    detail::write_float6(out, path.translate);
+    for (const float6x6& matrix : path.transforms) {
+        for (const float6* col : {&matrix.col1, &matrix.col2, &matrix.col3, &matrix.col4, &matrix.col5, &matrix.col6}) {
+            detail::write_float6(out, *col);
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+// 读取路径文件. 文件不存在, 格式不对或者参数和expected不一致时返回空
+[[nodiscard]] inline std::optional<CameraPath> load(const std::filesystem::path& file, const Settings& expected) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) { return std::nullopt; }
+    std::array<char, 8> magic{};
+    std::uint32_t version = 0;
+    CameraPath path;
+    if (
+        !in.read(magic.data(), magic.size()) || magic != detail::kMagic
+        || !detail::read_value(in, version) || version != detail::kVersion
+        || !detail::read_value(in, path.settings.seed)
+        || !detail::read_value(in, path.settings.keyframes)
+        || !detail::read_value(in, path.settings.frames)
+        || !detail::read_value(in, path.settings.scale)
+        || !(path.settings == expected)
+        || !detail::read_float6(in, path.translate)
+    ) {
+        return std::nullopt;
+    }
+    path.transforms.resize(path.settings.frames);
+    for (float6x6& matrix : path.transforms) {
+        for (float6* col : {&matrix.col1, &matrix.col2, &matrix.col3, &matrix.col4, &matrix.col5, &matrix.col6}) {
+            if (!detail::read_float6(in, *col)) { return std::nullopt; }
+        }
+    }
+    return path;
+}
+
+// 有匹配的缓存文件就直接读, 否则重新计算并写回文件
+[[nodiscard]] inline CameraPath load_or_make(const Settings& settings, const std::filesystem::path& file) {
+    if (std::optional<CameraPath> cached = load(file, settings)) { return std::move(*cached); }
+    CameraPath path = make_camera_path(settings);
+    if (!save(path, file)) { LUISA_WARNING("Failed to write camera path cache to {}", file.string()); }
+    return path;
+}
+}  // namespace camera_path
@@ -1,4 +1,6 @@
 #pragma once
+#include <limits>
+
 #include <luisa/luisa-compute.h>
 
 using namespace luisa;
@@ -21,9 +23,10 @@ LUISA_STRUCT(complex, real, imag) {
         return real * real + imag * imag;
     }
 
+    // ln|z|直接取ln|z|^2的一半, 不用先开方
     [[nodiscard]] Complex log_natural() const noexcept {
         return def<complex>(
-            log(sqrt(abs_square())),
+            0.5F * log(abs_square()),
             atan2(imag, real)
         );
     }
@@ -41,6 +44,33 @@ LUISA_STRUCT(complex, real, imag) {
             exponent * this->log_natural()
         )->exp();
     }
+
+    // 整数次幂: 按指数的二进制位平方再相乘, 负指数最后取倒数, 没有超越函数
+    [[nodiscard]] Complex pow_integer(const Int& exponent) const noexcept {
+        Complex result = def<complex>(1.F, 0.F);
+        Complex base = def<complex>(real, imag);
+        UInt remaining = abs(exponent).cast<uint>();
+        for (auto bit_idx: dynamic_range(32u)) {
+            if_(remaining == 0u, break_);
+            if_((remaining & 1u) != 0u, [&] { result = result * base; });
+            base = base * base;
+            remaining = remaining >> 1u;
+        };
+        if_(exponent < 0, [&] {
+            Float factor = 1.F / result->abs_square();
+            result = def<complex>(result.real * factor, -result.imag * factor);
+        });
+        return result;
+    }
+
+    /* 实数次幂, 极坐标形式 |z|^p (cos pθ, sin pθ). pow本身就是exp(p log), 超越函数和复数次幂一样多,
+     * 省下的只是X ln z的复数乘法(换成两次实数乘法)
+     */
+    [[nodiscard]] Complex pow_real(const Float& exponent) const noexcept {
+        Float magnitude = luisa::compute::pow(abs_square(), exponent * 0.5F);
+        Float angle = exponent * atan2(imag, real);
+        return def<complex>(magnitude * cos(angle), magnitude * sin(angle));
+    }
 };
 
 [[nodiscard]] inline Complex operator-(Complex val) {
@@ -83,4 +113,57 @@ LUISA_STRUCT(complex, real, imag) {
         (numerator.real * denominator.real + numerator.imag * denominator.imag) * factor,
         (-numerator.real * denominator.imag + numerator.imag * denominator.real) * factor
     );
-}
\ No newline at end of file
+}
+
+/* 带导数的复数(对偶数): value和它对某个复变量(迭代里是c)的导数, 运算时按链式法则同时算导数.
+ * 指数X, 常数和c以外的输入看作对c的常数
+ */
+struct dual_complex {
+    complex value, derivative;
+};
+
+using DualComplex = Var<dual_complex>;
+
+LUISA_STRUCT(dual_complex, value, derivative) {
+    // (e^z)' = e^z z'
+    [[nodiscard]] DualComplex exp() const noexcept {
+        Complex result = value->exp();
+        return def<dual_complex>(result, result * derivative);
+    }
+
+    // (ln z)' = z' / z
+    [[nodiscard]] DualComplex log_natural() const noexcept {
+        return def<dual_complex>(value->log_natural(), derivative / value);
+    }
+
+    /* value^exponent已经用别的算法(比如pow_integer)算好时只补上导数: (z^X)' = X z^X / z z'
+     * z = 0时z^X / z是0 / 0(经典的z_0 = 0平面第一步就是), 按Re X > 1时的极限取导数为0
+     */
+    [[nodiscard]] DualComplex pow_with(const Complex& power, const Complex& exponent) const noexcept {
+        Complex chained = def<complex>(0.F, 0.F);
+        if_(value->abs_square() >= std::numeric_limits<float>::min(), [&] {
+            chained = exponent * (power / value) * derivative;
+        });
+        return def<dual_complex>(power, chained);
+    }
+
+    [[nodiscard]] DualComplex pow(const Complex& exponent) const noexcept {
+        return pow_with(value->pow(exponent), exponent);
+    }
+};
+
+/*!	This operator implements dual addition.*/
+[[nodiscard]] inline DualComplex operator+(DualComplex lhs, DualComplex rhs) {
+    return def<dual_complex>(lhs.value + rhs.value, lhs.derivative + rhs.derivative);
+}
+/*!	This operator implements dual plus constant addition: the derivative is unchanged.*/
+[[nodiscard]] inline DualComplex operator+(DualComplex lhs, Complex rhs) {
+    return def<dual_complex>(lhs.value + rhs, lhs.derivative);
+}
+/*!	This operator implements dual multiplication with the product rule.*/
+[[nodiscard]] inline DualComplex operator*(DualComplex lhs, DualComplex rhs) {
+    return def<dual_complex>(
+        lhs.value * rhs.value,
+        lhs.value * rhs.derivative + lhs.derivative * rhs.value
+    );
+}
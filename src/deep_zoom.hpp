@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include <luisa/luisa-compute.h>
+#include "complex.hpp"
+#include "double_double.hpp"
+#include "float6.hpp"
+#include "mandelbrot_6d.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* 深度放大(微扰法): float的z, c在放大到1e-6左右后相邻像素就分不开了. 这里只在画面中心用double-double
+ * 在host上算一条参考轨道Z_k, 每个像素在设备上用float迭代它和参考轨道的差δ_k:
+ *     δ_{k+1} = (Z_k + δ_k)^n - Z_k^n + δc
+ * δ本身很小, float的相对精度足够. 只支持X是整帧常数的正整数n(切片平面里X的分量为0).
+ * 重新选基(rebasing): |Z_k + δ_k| < |δ_k|或者当前的参考轨道用完时, 令δ = z, 换到从临界点0出发(c相同)的第二条参考轨道的开头,
+ * 避免δ变得比z本身还大. 六维切片里z_0一般不是0, 所以不能像普通的mandelbrot集那样回到同一条轨道的开头.
+ * 毛刺检测(Pauldelbrot): |Z_k + δ_k| < ε|Z_k|时z由两个接近的数相减得到, 精度不可信, 统计这样的像素数.
+ * 参考轨道用完而被迫换轨道时δ = z并不小, 也算作毛刺; 第二条轨道只有一项(0本身就逃逸)时没法换, 直接停止迭代.
+ * 参考轨道的精度决定了最深能放到约1e-28(double-double的有效位), 像素间距也需要在float的范围内
+ */
+namespace deep_zoom {
+using double_double::ComplexDD;
+using double_double::DoubleDouble;
+
+constexpr float kGlitchTolerance = 1e-3F; // Pauldelbrot判据的ε
+constexpr uint kMaxExponent = 64;
+constexpr uint kScanSamples = 256;        // 找边界时画面中线上的采样数
+constexpr uint kBisectionSteps = 110;     // 区间缩小2^-110, 到double-double的精度以下
+
+// 放大的中心和画面平面
+struct View {
+    std::array<DoubleDouble, 6> center; // 顺序同float6: z_0, X, c各两个分量
+    float6 direction_u{};               // u从0到1时pos的变化(缩放为1时), X的分量为0
+    float6 direction_v{};
+    uint exponent = 2;                  // X = exponent + 0i
+};
+
+namespace detail {
+[[nodiscard]] inline std::array<double, 6> components(const float6& vec) {
+    return {vec.first.x, vec.first.y, vec.first.z, vec.second.x, vec.second.y, vec.second.z};
+}
+
+// 去掉X的两个分量, 使整个画面的X相同
+[[nodiscard]] inline float6 without_exponent(float6 vec) {
+    vec.first.z = 0.F;
+    vec.second.x = 0.F;
+    return vec;
+}
+
+// center + direction * offset
+[[nodiscard]] inline std::array<DoubleDouble, 6> offset_position(
+    const std::array<DoubleDouble, 6>& center, const float6& direction, const DoubleDouble& offset
+) {
+    const std::array<double, 6> steps = components(direction);
+    std::array<DoubleDouble, 6> result;
+    for (size_t idx = 0; idx < 6; ++idx) { result[idx] = center[idx] + DoubleDouble(steps[idx]) * offset; }
+    return result;
+}
+
+[[nodiscard]] inline ComplexDD start_z(const std::array<DoubleDouble, 6>& pos) { return {pos[0], pos[1]}; }
+
+[[nodiscard]] inline ComplexDD constant_c(const std::array<DoubleDouble, 6>& pos) { return {pos[4], pos[5]}; }
+
+// 逃逸条件同mandelbrot_6d::iterate: |z - z_0|^2 > 1000, 差值很大时不需要double-double的精度
+[[nodiscard]] inline bool escaped(const ComplexDD& mb_z, const ComplexDD& original_z) {
+    return (mb_z - original_z).abs_square().to_double() > 1000.;
+}
+
+[[nodiscard]] inline bool escapes(const std::array<DoubleDouble, 6>& pos, uint exponent, uint max_iterations) {
+    const ComplexDD original_z = start_z(pos);
+    const ComplexDD mb_c = constant_c(pos);
+    ComplexDD mb_z = original_z;
+    for (uint iterations_cnt = 0; iterations_cnt < max_iterations; ++iterations_cnt) {
+        if (escaped(mb_z, original_z)) { return true; }
+        mb_z = double_double::pow(mb_z, exponent) + mb_c;
+    }
+    return false;
+}
+}  // namespace detail
+
+/* 从一帧的变换和平移得到放大的画面: 平面取变换的前两列(去掉X的分量), X固定为exponent.
+ * 中心从平移出发, 在画面的水平中线上均匀采样, 找到离中心最近的逃逸状态改变的相邻两点, 在它们之间二分到分界上,
+ * 这样放大到任意深度都还在集合的边界附近(整条中线的逃逸状态都相同时就用平移本身)
+ */
+[[nodiscard]] inline View make_view(
+    const float6x6& transform, const float6& translate_vec, uint exponent, uint max_iterations
+) {
+    View view;
+    view.direction_u = detail::without_exponent(transform.col1);
+    view.direction_v = detail::without_exponent(transform.col2);
+    view.exponent = std::clamp(exponent, 1u, kMaxExponent);
+    const std::array<double, 6> translate_components = detail::components(translate_vec);
+    for (size_t idx = 0; idx < 6; ++idx) { view.center[idx] = translate_components[idx]; }
+    view.center[2] = static_cast<double>(view.exponent);
+    view.center[3] = 0.;
+
+    const auto escapes_at = [&](const DoubleDouble& offset) {
+        return detail::escapes(detail::offset_position(view.center, view.direction_u, offset), view.exponent, max_iterations);
+    };
+    const auto sample_offset = [](uint sample) {
+        return static_cast<double>(sample) / static_cast<double>(kScanSamples) - .5;
+    };
+    std::vector<char> sample_escapes(kScanSamples + 1);
+    for (uint sample = 0; sample <= kScanSamples; ++sample) { sample_escapes[sample] = escapes_at(sample_offset(sample)); }
+    uint best = kScanSamples;
+    for (uint sample = 0; sample < kScanSamples; ++sample) {
+        const bool closer = best == kScanSamples
+            || std::abs(sample_offset(sample) + .5 / kScanSamples) < std::abs(sample_offset(best) + .5 / kScanSamples);
+        if (sample_escapes[sample] != sample_escapes[sample + 1] && closer) { best = sample; }
+    }
+    if (best == kScanSamples) { return view; }
+
+    DoubleDouble low = sample_offset(best);
+    DoubleDouble high = sample_offset(best + 1);
+    const bool low_escapes = sample_escapes[best] != 0;
+    for (uint step = 0; step < kBisectionSteps; ++step) {
+        const DoubleDouble middle = (low + high) * DoubleDouble(.5);
+        if (escapes_at(middle) == low_escapes) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    // 取不逃逸的一端, 参考轨道尽量长: 像素迭代到参考轨道的末尾时只能从Z_0重新开始, δ不再小, 精度随之下降
+    view.center = detail::offset_position(view.center, view.direction_u, low_escapes ? high : low);
+    return view;
+}
+
+namespace detail {
+/* 从start出发的参考轨道, 迭代规则和逃逸条件同mandelbrot_6d::iterate(不做周期检测, 逃逸按画面中心的z_0算),
+ * 逃逸的那一项也存下, 最多max_iterations + 1项
+ */
+[[nodiscard]] inline std::vector<float2> orbit_from(const View& view, const ComplexDD& start, uint max_iterations) {
+    const ComplexDD original_z = start_z(view.center);
+    const ComplexDD mb_c = constant_c(view.center);
+    ComplexDD mb_z = start;
+    std::vector<float2> orbit;
+    orbit.reserve(max_iterations + 1);
+    orbit.push_back(make_float2(static_cast<float>(mb_z.real.to_double()), static_cast<float>(mb_z.imag.to_double())));
+    for (uint iterations_cnt = 0; iterations_cnt < max_iterations && !escaped(mb_z, original_z); ++iterations_cnt) {
+        mb_z = double_double::pow(mb_z, view.exponent) + mb_c;
+        orbit.push_back(make_float2(static_cast<float>(mb_z.real.to_double()), static_cast<float>(mb_z.imag.to_double())));
+    }
+    return orbit;
+}
+}  // namespace detail
+
+// 画面中心的轨道, 每个像素从它开始
+[[nodiscard]] inline std::vector<float2> reference_orbit(const View& view, uint max_iterations) {
+    return detail::orbit_from(view, detail::start_z(view.center), max_iterations);
+}
+
+// 从临界点0出发的轨道, 重新选基之后用
+[[nodiscard]] inline std::vector<float2> critical_orbit(const View& view, uint max_iterations) {
+    return detail::orbit_from(view, ComplexDD{0., 0.}, max_iterations);
+}
+
+class DeepZoomRenderer {
+public:
+    /* counters: 毛刺计数器的个数. 流水线里同时在飞的每一帧各用一个(见render的counter),
+     * 计数和像素一起拷回, 不需要每帧单独同步
+     */
+    DeepZoomRenderer(Device& device, uint max_iterations, uint counters = 1)
+        : max_iterations_(max_iterations),
+          reference_(device.create_buffer<float2>(2 * (max_iterations + 1))),
+          glitches_(device.create_buffer<uint>(std::max(1u, counters))),
+          shader_(device.compile(perturbation_kernel())) {}
+
+    // 算两条参考轨道并依次上传, 之后的render都用这个画面. 会同步stream
+    void set_view(Stream& stream, const View& view) {
+        view_ = view;
+        const std::vector<float2> reference = reference_orbit(view, max_iterations_);
+        const std::vector<float2> critical = critical_orbit(view, max_iterations_);
+        reference_len_ = static_cast<uint>(reference.size());
+        critical_len_ = static_cast<uint>(critical.size());
+        stream
+            << reference_.view(0, reference.size()).copy_from(reference.data())
+            << reference_.view(reference.size(), critical.size()).copy_from(critical.data())
+            << synchronize();
+    }
+
+    /* 把一帧提交到stream上, scale是画面相对View的缩放(放大时小于1).
+     * 毛刺像素数累加到第counter个计数器, 这个计数器在读回之前不能给别的帧用
+     */
+    void render(Stream& stream, const Image<float>& image, float scale, uint counter = 0) {
+        const float6 delta_u = scaled(view_.direction_u, scale);
+        const float6 delta_v = scaled(view_.direction_v, scale);
+        stream
+            << glitches_.view(counter, 1).copy_from(&zero_)
+            << shader_(
+                image, reference_, reference_len_, critical_len_, delta_u, delta_v, view_.exponent, max_iterations_,
+                glitches_, counter
+            ).dispatch(image.size());
+    }
+
+    // 把第counter个计数器拷到count, 只是提交到stream上, 和像素一样等stream(或者之后的事件)完成后才能读
+    void copy_glitch_count(Stream& stream, uint counter, uint& count) const {
+        stream << glitches_.view(counter, 1).copy_to(&count);
+    }
+
+    [[nodiscard]] uint reference_length() const { return reference_len_; }
+
+    [[nodiscard]] uint critical_length() const { return critical_len_; }
+
+private:
+    [[nodiscard]] static float6 scaled(const float6& vec, float scale) {
+        return make_float6(
+            vec.first.x * scale, vec.first.y * scale, vec.first.z * scale,
+            vec.second.x * scale, vec.second.y * scale, vec.second.z * scale
+        );
+    }
+
+    // reference里先是画面中心的轨道(reference_len项), 接着是从0出发的轨道(critical_len项)
+    static Kernel2D<Image<float>, Buffer<float2>, uint, uint, float6, float6, uint, uint, Buffer<uint>, uint> perturbation_kernel() {
+        return [](
+            ImageFloat image, BufferFloat2 reference, UInt reference_len, UInt critical_len, const Float6& delta_u,
+            const Float6& delta_v, UInt exponent, UInt max_iterations, BufferUInt glitches, UInt counter
+        ) {
+            set_block_size(16, 16);
+            UInt2 pixel = dispatch_id().xy();
+            Float2 uv_pos = mandelbrot_6d::pixel_uv(pixel, dispatch_size().xy());
+            Float2 offset = uv_pos - make_float2(.5F);
+            Float6 delta_pos = delta_u * offset.x + delta_v * offset.y;
+            Complex delta_z0{delta_pos.first.x, delta_pos.first.y};
+            Complex delta_c{delta_pos.second.y, delta_pos.second.z};
+            Float2 first = reference.read(0u);
+            Complex reference_z0 = def<complex>(first.x, first.y);
+
+            Complex delta = delta_z0;
+            UInt orbit_begin = 0u; // 当前参考轨道在reference里的起点和长度
+            UInt orbit_len = reference_len;
+            UInt reference_idx = 0u;
+            UInt iterations_cnt = 0u;
+            Bool glitched = false;
+            Float glitch_tolerance_square = kGlitchTolerance * kGlitchTolerance;
+            for (auto iterate_idx: dynamic_range(max_iterations)) {
+                iterations_cnt += 1u;
+                Float2 current = reference.read(orbit_begin + reference_idx);
+                Complex reference_z = def<complex>(current.x, current.y);
+                // z - z_0 = (Z - Z_0) + (δ - δ_0), 先各自相减, 不让大数和小数直接相加
+                if_(((reference_z - reference_z0) + (delta - delta_z0))->abs_square() > 1000.F, break_);
+
+                Complex mb_z = reference_z + delta;
+                if_(reference_idx > 0u && mb_z->abs_square() < glitch_tolerance_square * reference_z->abs_square(), [&] {
+                    glitched = true;
+                });
+
+                // (Z + δ)^n - Z^n = δ Σ_{j < n} (Z + δ)^j Z^(n - 1 - j), 按Horner的方式累加, 没有大数相减
+                Complex sum = def<complex>(1.F, 0.F);
+                Complex power = sum;
+                for (auto term_idx: dynamic_range(exponent - 1u)) {
+                    power = power * mb_z;
+                    sum = sum * reference_z + power;
+                };
+                delta = delta * sum + delta_c;
+                reference_idx += 1u;
+
+                Float2 next = reference.read(orbit_begin + reference_idx);
+                Complex next_z = def<complex>(next.x, next.y) + delta;
+                Bool exhausted = reference_idx + 1u >= orbit_len;
+                if_(exhausted, [&] { glitched = true; });
+                // 第二条轨道从0出发, 换过去时δ就是z. 它只有一项时读下一项会越界, 不换
+                if_(critical_len <= 1u, [&] {
+                    if_(exhausted, break_);
+                }).elif_(next_z->abs_square() < delta->abs_square() || exhausted, [&] {
+                    delta = next_z;
+                    orbit_begin = reference_len;
+                    orbit_len = critical_len;
+                    reference_idx = 0u;
+                });
+            };
+            if_(glitched, [&] { glitches.atomic(counter).fetch_add(1u); });
+            image.write(pixel, mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos));
+        };
+    }
+
+    uint max_iterations_;
+    uint reference_len_ = 0;
+    uint critical_len_ = 0;
+    uint zero_ = 0;
+    View view_;
+    Buffer<float2> reference_;  // 两条参考轨道, float精度
+    Buffer<uint> glitches_;     // 每个计数器一个毛刺像素数
+    Shader2D<Image<float>, Buffer<float2>, uint, uint, float6, float6, uint, uint, Buffer<uint>, uint> shader_;
+};
+}  // namespace deep_zoom
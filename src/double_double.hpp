@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cmath>
+
+/* double-double: 用两个double的和表示一个数, 高位hi, 低位lo(|lo| <= ulp(hi) / 2), 约106位有效数字.
+ * 只在host上用(深度放大的参考轨道, 见deep_zoom.hpp), 加减乘都是无分支的误差补偿算法, 依赖std::fma
+ */
+namespace double_double {
+struct DoubleDouble {
+    double hi = 0;
+    double lo = 0;
+
+    DoubleDouble() = default;
+    DoubleDouble(double val) : hi(val) {} // 不加explicit, 和double混合运算时隐式转换
+    DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+    [[nodiscard]] double to_double() const { return hi + lo; }
+};
+
+namespace detail {
+// a + b = s + err, 精确
+[[nodiscard]] inline DoubleDouble two_sum(double lhs, double rhs) {
+    const double sum = lhs + rhs;
+    const double rhs_part = sum - lhs;
+    return {sum, (lhs - (sum - rhs_part)) + (rhs - rhs_part)};
+}
+
+// 同two_sum, 要求|lhs| >= |rhs|
+[[nodiscard]] inline DoubleDouble quick_two_sum(double lhs, double rhs) {
+    const double sum = lhs + rhs;
+    return {sum, rhs - (sum - lhs)};
+}
+}  // namespace detail
+
+[[nodiscard]] inline DoubleDouble operator-(const DoubleDouble& val) { return {-val.hi, -val.lo}; }
+
+[[nodiscard]] inline DoubleDouble operator+(const DoubleDouble& lhs, const DoubleDouble& rhs) {
+    const DoubleDouble high = detail::two_sum(lhs.hi, rhs.hi);
+    const DoubleDouble low = detail::two_sum(lhs.lo, rhs.lo);
+    const DoubleDouble partial = detail::quick_two_sum(high.hi, high.lo + low.hi);
+    return detail::quick_two_sum(partial.hi, partial.lo + low.lo);
+}
+
+[[nodiscard]] inline DoubleDouble operator-(const DoubleDouble& lhs, const DoubleDouble& rhs) { return lhs + (-rhs); }
+
+[[nodiscard]] inline DoubleDouble operator*(const DoubleDouble& lhs, const DoubleDouble& rhs) {
+    const double product = lhs.hi * rhs.hi;
+    const double error = std::fma(lhs.hi, rhs.hi, -product) + (lhs.hi * rhs.lo + lhs.lo * rhs.hi);
+    return detail::quick_two_sum(product, error);
+}
+
+// 复数, 分量都是DoubleDouble
+struct ComplexDD {
+    DoubleDouble real;
+    DoubleDouble imag;
+
+    [[nodiscard]] DoubleDouble abs_square() const { return real * real + imag * imag; }
+};
+
+[[nodiscard]] inline ComplexDD operator+(const ComplexDD& lhs, const ComplexDD& rhs) {
+    return {lhs.real + rhs.real, lhs.imag + rhs.imag};
+}
+
+[[nodiscard]] inline ComplexDD operator-(const ComplexDD& lhs, const ComplexDD& rhs) {
+    return {lhs.real - rhs.real, lhs.imag - rhs.imag};
+}
+
+[[nodiscard]] inline ComplexDD operator*(const ComplexDD& lhs, const ComplexDD& rhs) {
+    return {lhs.real * rhs.real - lhs.imag * rhs.imag, lhs.real * rhs.imag + lhs.imag * rhs.real};
+}
+
+// 正整数次幂, 平方求积
+[[nodiscard]] inline ComplexDD pow(const ComplexDD& base, unsigned exponent) {
+    ComplexDD result{1., 0.};
+    ComplexDD power = base;
+    for (; exponent != 0; exponent >>= 1u) {
+        if ((exponent & 1u) != 0) { result = result * power; }
+        power = power * power;
+    }
+    return result;
+}
+}  // namespace double_double
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <stb/stb_image_write.h>
+#include "ext/tinyexr.h" // 在一个.cpp里先定义TINYEXR_IMPLEMENTATION再包含本文件
+
+/* 帧序列的异步编码: 渲染循环把拷回的像素交给FrameEncoder, 多个工作线程并行编码写文件
+ * 队列有上限, 满了以后submit会阻塞, 渲染自然就慢下来等编码(背压), 内存占用不会无限增长.
+ * 写完的像素缓冲区留着给下一帧复用(take_buffer), 不用每帧重新分配
+ */
+namespace frame_encoder {
+enum class Format : std::uint8_t {
+    kPng, // 8位RGBA, stb_image_write
+    kExr, // 半精度浮点RGBA, tinyexr. 像素按[0, 1]换算
+    kRaw, // 不压缩, 直接写出RGBA字节(ffmpeg用-f image2 -c:v rawvideo读)
+    kAov  // 多通道浮点EXR, 像素是按通道分开存放的float, 通道名见Frame::channel_names
+};
+
+// 文件扩展名, 不带点
+[[nodiscard]] inline std::string_view extension(Format format) {
+    switch (format) {
+        case Format::kExr:
+        case Format::kAov: return "exr";
+        case Format::kRaw: return "rgba";
+        default: return "png";
+    }
+}
+
+// 从名字解析格式(png, exr, raw), 不认识的名字返回false
+[[nodiscard]] inline bool parse_format(std::string_view name, Format& format) {
+    if (name == "png") { format = Format::kPng; return true; }
+    if (name == "exr") { format = Format::kExr; return true; }
+    if (name == "raw") { format = Format::kRaw; return true; }
+    return false;
+}
+
+// 一帧: 8位RGBA像素(kAov时是每个通道width * height个float依次排列), 编码器接管pixels
+struct Frame {
+    std::filesystem::path file;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::vector<std::byte> pixels;
+    std::span<const char* const> channel_names{}; // 只有kAov用, 指向的名字要比编码器活得久
+};
+
+/* 按通道分开存放的float数据写成EXR, 每个通道width * height个float, 通道名按EXR的要求需要是字母序
+ * 数值原样按32位浮点保存. 失败时返回false
+ */
+inline bool write_exr_channels(
+    const std::filesystem::path& file, int width, int height, std::span<const char* const> names, const float* planar
+) {
+    const auto channel_cnt = static_cast<int>(names.size());
+    const size_t pixel_cnt = static_cast<size_t>(width) * static_cast<size_t>(height);
+    std::vector<const float*> images(names.size());
+    std::vector<EXRChannelInfo> channels(names.size());
+    for (size_t channel = 0; channel < names.size(); ++channel) {
+        images[channel] = planar + channel * pixel_cnt;
+        std::strncpy(channels[channel].name, names[channel], sizeof(channels[channel].name) - 1);
+    }
+    std::vector<int> pixel_types(names.size(), TINYEXR_PIXELTYPE_FLOAT);
+
+    EXRImage image;
+    InitEXRImage(&image);
+    image.num_channels = channel_cnt;
+    image.images = reinterpret_cast<unsigned char**>(const_cast<float**>(images.data()));
+    image.width = width;
+    image.height = height;
+
+    EXRHeader header;
+    InitEXRHeader(&header);
+    header.num_channels = channel_cnt;
+    header.channels = channels.data();
+    header.pixel_types = pixel_types.data();
+    header.requested_pixel_types = pixel_types.data();
+    header.compression_type = TINYEXR_COMPRESSIONTYPE_ZIP;
+
+    const char* err = nullptr;
+    if (SaveEXRImageToFile(&image, &header, file.string().c_str(), &err) != TINYEXR_SUCCESS) {
+        if (err != nullptr) { FreeEXRErrorMessage(err); }
+        return false;
+    }
+    return true;
+}
+
+/* 读write_exr_channels写的文件: 按names的顺序取出通道, 半精度通道转成float
+ * 文件不存在, 尺寸不是width x height或者缺少通道时返回false
+ */
+inline bool read_exr_channels(
+    const std::filesystem::path& file, int width, int height, std::span<const char* const> names, std::vector<float>& planar
+) {
+    const std::string file_name = file.string();
+    EXRVersion version;
+    if (ParseEXRVersionFromFile(&version, file_name.c_str()) != TINYEXR_SUCCESS) { return false; }
+    EXRHeader header;
+    InitEXRHeader(&header);
+    const char* err = nullptr;
+    if (ParseEXRHeaderFromFile(&header, &version, file_name.c_str(), &err) != TINYEXR_SUCCESS) {
+        if (err != nullptr) { FreeEXRErrorMessage(err); }
+        return false;
+    }
+    for (int channel = 0; channel < header.num_channels; ++channel) {
+        header.requested_pixel_types[channel] = TINYEXR_PIXELTYPE_FLOAT;
+    }
+    EXRImage image;
+    InitEXRImage(&image);
+    if (LoadEXRImageFromFile(&image, &header, file_name.c_str(), &err) != TINYEXR_SUCCESS) {
+        if (err != nullptr) { FreeEXRErrorMessage(err); }
+        FreeEXRHeader(&header);
+        return false;
+    }
+
+    bool success = image.images != nullptr && image.width == width && image.height == height;
+    const size_t pixel_cnt = static_cast<size_t>(width) * static_cast<size_t>(height);
+    planar.resize(pixel_cnt * names.size());
+    for (size_t idx = 0; success && idx < names.size(); ++idx) {
+        int found = -1;
+        for (int channel = 0; channel < header.num_channels; ++channel) {
+            if (std::strcmp(header.channels[channel].name, names[idx]) == 0) { found = channel; }
+        }
+        if (found < 0) {
+            success = false;
+        } else {
+            const auto* values = reinterpret_cast<const float*>(image.images[found]);
+            std::copy(values, values + pixel_cnt, planar.begin() + static_cast<std::ptrdiff_t>(idx * pixel_cnt));
+        }
+    }
+    FreeEXRImage(&image);
+    FreeEXRHeader(&header);
+    return success;
+}
+
+// 同步写一帧, 失败时返回false
+inline bool write_frame(const Frame& frame, Format format) {
+    const std::string file = frame.file.string();
+    const int width = static_cast<int>(frame.width);
+    const int height = static_cast<int>(frame.height);
+    switch (format) {
+        case Format::kPng:
+            return stbi_write_png(file.c_str(), width, height, 4, frame.pixels.data(), 0) != 0;
+        case Format::kExr: {
+            std::vector<float> values(frame.pixels.size());
+            std::transform(frame.pixels.begin(), frame.pixels.end(), values.begin(), [](std::byte val) {
+                return static_cast<float>(std::to_integer<std::uint8_t>(val)) * (1.F / 255.F);
+            });
+            const char* err = nullptr;
+            if (SaveEXR(values.data(), width, height, 4, 1, file.c_str(), &err) != TINYEXR_SUCCESS) {
+                if (err != nullptr) { FreeEXRErrorMessage(err); }
+                return false;
+            }
+            return true;
+        }
+        case Format::kRaw: {
+            std::ofstream out(frame.file, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(frame.pixels.data()), static_cast<std::streamsize>(frame.pixels.size()));
+            return static_cast<bool>(out);
+        }
+        case Format::kAov:
+            return write_exr_channels(
+                frame.file, width, height, frame.channel_names, reinterpret_cast<const float*>(frame.pixels.data())
+            );
+    }
+    return false;
+}
+
+class FrameEncoder {
+public:
+    /* workers: 工作线程数, 0表示硬件线程数减1(留一个给渲染循环)
+     * capacity: 排队等待编码的最多帧数, 不包括正在编码的
+     */
+    explicit FrameEncoder(Format format, size_t workers = 0, size_t capacity = 8)
+        : format_(format), capacity_(std::max<size_t>(1, capacity)) {
+        // hardware_concurrency()可能返回0(未知), 先取到至少2再减1, 不会回绕
+        if (workers == 0) { workers = std::max<size_t>(2, std::thread::hardware_concurrency()) - 1; }
+        workers_.reserve(workers);
+        for (size_t idx = 0; idx < workers; ++idx) {
+            workers_.emplace_back([this] { run(); });
+        }
+    }
+
+    FrameEncoder(const FrameEncoder&) = delete;
+    FrameEncoder& operator=(const FrameEncoder&) = delete;
+
+    // 写完队列里剩下的帧再退出
+    ~FrameEncoder() {
+        {
+            const std::lock_guard lock(mutex_);
+            closing_ = true;
+        }
+        not_empty_.notify_all();
+        workers_.clear(); // jthread析构时join
+    }
+
+    [[nodiscard]] Format format() const { return format_; }
+
+    // 取一块至少size字节的缓冲区, 优先复用已经写完的帧
+    [[nodiscard]] std::vector<std::byte> take_buffer(size_t size) {
+        std::vector<std::byte> buffer;
+        {
+            const std::lock_guard lock(mutex_);
+            if (!spare_.empty()) {
+                buffer = std::move(spare_.back());
+                spare_.pop_back();
+            }
+        }
+        buffer.resize(size);
+        return buffer;
+    }
+
+    // 提交一帧, 队列满时阻塞到有空位
+    void submit(Frame frame) {
+        {
+            std::unique_lock lock(mutex_);
+            not_full_.wait(lock, [this] { return queue_.size() < capacity_; });
+            queue_.push_back(std::move(frame));
+        }
+        not_empty_.notify_one();
+    }
+
+    // 等到已经提交的帧全部写完
+    void wait() {
+        std::unique_lock lock(mutex_);
+        idle_.wait(lock, [this] { return queue_.empty() && busy_ == 0; });
+    }
+
+    // 写失败的帧数
+    [[nodiscard]] size_t failures() const { return failures_.load(); }
+
+private:
+    void run() {
+        while (true) {
+            Frame frame;
+            {
+                std::unique_lock lock(mutex_);
+                not_empty_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+                if (queue_.empty()) { return; }
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+                ++busy_;
+            }
+            not_full_.notify_one();
+
+            if (!write_frame(frame, format_)) { ++failures_; }
+
+            {
+                const std::lock_guard lock(mutex_);
+                spare_.push_back(std::move(frame.pixels));
+                --busy_;
+            }
+            idle_.notify_all();
+        }
+    }
+
+    Format format_;
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable idle_;
+    std::deque<Frame> queue_;
+    std::vector<std::vector<std::byte>> spare_;
+    size_t busy_ = 0;
+    bool closing_ = false;
+    std::atomic<size_t> failures_{0};
+    std::vector<std::jthread> workers_; // 放在最后, 析构时先join工作线程, 再销毁它们用到的成员
+};
+}  // namespace frame_encoder
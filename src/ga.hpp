@@ -2,14 +2,16 @@
 
 #include <array>
 #include <bit>
+#include <cstdint>
 #include <iostream>
-#include <numbers>
-#include <random>
+#include <limits>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 #include <luisa/luisa-compute.h>
 #include "float6.hpp"
+#include "ga_simd.hpp"
 
 using namespace luisa;
 using namespace luisa::compute;
@@ -29,6 +31,45 @@ concept ga_concept = requires() {
 };
 }  // namespace
 
+/* GeoAlg的系数数组, 另外维护一个非零基的位掩码(第i位对应第i个系数). 掩码只是上界, 不会漏掉非零的系数:
+ * 通过非const的下标写入时置上那一位(写入的是0也一样), 取出可写的指针或迭代器时置上所有位. 只能靠restrict_mask收紧
+ */
+template <typename T, size_t N>
+class alignas(32) BladeArray {
+public:
+    static_assert(N <= 64);
+    static constexpr std::uint64_t kAllBlades = N == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << N) - 1;
+
+    [[nodiscard]] constexpr const T& operator[](size_t idx) const { return values_[idx]; }
+    [[nodiscard]] constexpr T& operator[](size_t idx) {
+        mask_ |= std::uint64_t(1) << idx;
+        return values_[idx];
+    }
+
+    [[nodiscard]] constexpr const T* data() const { return values_.data(); }
+    [[nodiscard]] constexpr T* data() {
+        mask_ = kAllBlades;
+        return values_.data();
+    }
+    [[nodiscard]] static constexpr size_t size() { return N; }
+    [[nodiscard]] constexpr const T* begin() const { return data(); }
+    [[nodiscard]] constexpr const T* end() const { return data() + N; }
+    [[nodiscard]] constexpr T* begin() { return data(); }
+    [[nodiscard]] constexpr T* end() { return data() + N; }
+
+    // 可能非零的基
+    [[nodiscard]] constexpr std::uint64_t mask() const { return mask_; }
+
+    // 掩码和mask取交集, 调用方保证mask以外的系数都是0
+    constexpr void restrict_mask(std::uint64_t mask) { mask_ &= mask; }
+
+    [[nodiscard]] constexpr bool operator==(const BladeArray& other) const { return values_ == other.values_; }
+
+private:
+    std::array<T, N> values_{};
+    std::uint64_t mask_ = 0;
+};
+
 template <
     typename T,                      // 系数的类型
     size_t NBase,                    // 基个数
@@ -37,75 +78,125 @@ template <
     requires ga_concept<T, NBase, BaseSquares>
 class GeoAlg {
 private:
-    static constexpr std::pair<T, size_t> get_mul_table(size_t idx_a, size_t idx_b) {
-        size_t result_base = idx_a ^ idx_b;
-        T sign = 1;
-        std::array<size_t, NBase*2> mul{};
-        size_t mul_size = 0;
-
-        // 把idx_a, idx_b中的单个基放到mul里, 如e_{014} ==> {0, 1, 4}
+    // 平方为负数/0的基的位掩码
+    static constexpr size_t kNegativeMask = [] {
+        size_t mask = 0;
         for (size_t i = 0; i < NBase; ++i) {
-            if (idx_a & (1 << i)) {
-                mul[mul_size++] = i;
-            }
+            if (BaseSquares[i] < T(0)) { mask |= size_t(1) << i; }
         }
+        return mask;
+    }();
+    static constexpr size_t kZeroMask = [] {
+        size_t mask = 0;
         for (size_t i = 0; i < NBase; ++i) {
-            if (idx_b & (1 << i)) {
-                mul[mul_size++] = i;
-            }
+            if (BaseSquares[i] == T(0)) { mask |= size_t(1) << i; }
         }
+        return mask;
+    }();
 
-        // 用冒泡排序计算sign
-        if (mul_size > 1) {
-            for (size_t i = 0; i < mul_size-1; ++i) {
-                for (size_t j = 0; j < mul_size-i-1; ++j) {
-                    if (mul[j] > mul[j+1]) {
-                        auto tmp = mul[j];
-                        mul[j] = mul[j+1];
-                        mul[j+1] = tmp;
-                        sign *= -1;
-                    }
-                }
-            }
-            for (size_t i = 0; i < mul_size-1; ++i) {
-                if (mul[i] == mul[i+1]) {
-                    sign *= BaseSquares[mul[i]];
-                }
-            }
+    // 所有基的平方都是-1, 0或1时, 符号只靠上面两个掩码就能算出来
+    static constexpr bool kUnitMetric = [] {
+        for (const T square : BaseSquares) {
+            if (square != T(1) && square != T(-1) && square != T(0)) { return false; }
+        }
+        return true;
+    }();
+
+    /* 基a乘任意基b时的变号掩码: popcount(b & mask)为奇数时积为负
+     * 排序时a的第i个基要越过b中所有编号比i小的基, 交换次数的奇偶是popcount(b & (2^i - 1))之和的奇偶,
+     * 奇偶性对异或是线性的, 所以把这些低位掩码异或起来即可; 再加上a中平方为负的基
+     */
+    static constexpr size_t flip_mask(size_t idx_a) {
+        size_t mask = idx_a & kNegativeMask;
+        for (size_t i = 0; i < NBase; ++i) {
+            if (idx_a & (size_t(1) << i)) { mask ^= (size_t(1) << i) - 1; }
         }
+        return mask;
+    }
 
-        return {sign, result_base};
+    // 度量不全是±1, 0时, 共有的基还要乘上平方的绝对值
+    static constexpr T metric_scale(size_t common) {
+        T scale = T(1);
+        if constexpr (!kUnitMetric) {
+            for (size_t i = 0; i < NBase; ++i) {
+                if (common & (size_t(1) << i)) { scale *= std::abs(BaseSquares[i]); }
+            }
+        }
+        return scale;
     }
 
 public:
-    static constexpr size_t kBasesCnt = 1 << NBase /* 实数1这里也视为一个基 */;
+    static constexpr size_t kBasesCnt = size_t(1) << NBase /* 实数1这里也视为一个基 */;
+    static constexpr size_t kVectorsCnt = NBase;
     using this_type = GeoAlg<T, NBase, BaseSquares>;
+    using value_type = T;
+
+    // 基数不超过64时系数数组另外维护非零基的掩码(BladeArray), 乘法按它选算法
+    static constexpr bool kTracked = kBasesCnt <= 64;
+    using storage_type = std::conditional_t<kTracked, BladeArray<T, kBasesCnt>, std::array<T, kBasesCnt>>;
 
     /* data数组的第i项代表基i的系数
      * 若i除以(2的n次方)的余数为1则表示数组索引为n的基在多项式this的当前项中
      * i为0代表标量部分
      */
-    std::array<T, kBasesCnt> data{0.};
+    storage_type data{};
 
-    /* MulTable结构：mult_table[a][b] = {sign, base}
-     * 其中sign是积的符号(-1, 0, 1中的一个), base是结果的基(data数组的索引)
+    /* 基a乘基b的符号(-1, 0, 1中的一个), 结果的基是a ^ b
+     * 交换次数的奇偶决定正负, 两边共有的基按度量收缩: 有平方为0的基则为0, 平方为负的基每个贡献一个负号
+     * 只用位运算, 不需要kBasesCnt^2大小的表, 8~10个基也没问题
      */
-    inline const static
-    std::array<std::array<std::pair<T, size_t>, kBasesCnt>, kBasesCnt>
-    kMulTable = [] {
-        std::array<std::array<std::pair<T, size_t>, kBasesCnt>, kBasesCnt> table{};
+    static constexpr T blade_sign(size_t idx_a, size_t idx_b) {
+        const size_t common = idx_a & idx_b;
+        if (common & kZeroMask) { return T(0); }
+        const T sign = std::popcount(idx_b & flip_mask(idx_a)) % 2 == 0 ? T(1) : T(-1);
+        return sign * metric_scale(common);
+    }
 
-        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
-            for (size_t idx_b = 0; idx_b < kBasesCnt; ++idx_b) {
-                table[idx_a][idx_b] = get_mul_table(idx_a, idx_b);
-            }
-        }
+    // 伪标量的平方
+    constexpr static T kPseudoscalarSquare = blade_sign(kBasesCnt-1, kBasesCnt-1);
 
-        return table;
-    }();
+    // 基数不超过这个值时, 乘法在编译期完全展开; 否则退回运行时的循环, 符号用位运算现算
+    constexpr static bool kUnrolled = NBase <= 6;
 
-    // 伪标量的平方
-    constexpr static T kPseudoscalarSquare = get_mul_table(kBasesCnt-1, kBasesCnt-1).first;
+    // 乘法的种类. 内积/外积在编译期筛掉不需要的项
+    enum class ProductKind : std::uint8_t {
+        kGeometric, // 几何积
+        kInner,     // 内积, 保留|grade_a - grade_b|阶
+        kOuter      // 外积, 保留grade_a + grade_b阶
+    };
+
+    /* 逐基的符号变换, 可以直接并进乘法的符号里(见fused_product)
+     * 取值按位组合: 第0位是反转, 第1位是分级对合, 两个变换可交换, 复合就是异或
+     */
+    enum class BladeMap : std::uint8_t {
+        kIdentity = 0,
+        kReverse = 1,     // (-1)^{k(k-1)/2}
+        kInvolution = 2,  // (-1)^k
+        kConjugate = 3    // 反转再分级对合
+    };
+
+    static constexpr BladeMap compose(BladeMap lhs, BladeMap rhs) {
+        return static_cast<BladeMap>(static_cast<std::uint8_t>(lhs) ^ static_cast<std::uint8_t>(rhs));
+    }
+
+    // 变换map作用在基idx上的符号
+    static constexpr T map_sign(BladeMap map, size_t idx) {
+        const auto grade = std::popcount(idx);
+        bool negative = false;
+        if (static_cast<std::uint8_t>(map) & 1) { negative ^= grade % 4 == 2 || grade % 4 == 3; }
+        if (static_cast<std::uint8_t>(map) & 2) { negative ^= grade % 2 == 1; }
+        return negative ? T(-1) : T(1);
+    }
+
+    // 所有阶数的掩码, 第k位表示k阶
+    static constexpr size_t kAllGrades = (size_t(1) << (NBase + 1)) - 1;
+    static constexpr size_t kVectorGrades = 0b10;
+    static constexpr size_t kEvenGrades = [] {
+        size_t mask = 0;
+        for (size_t grade = 0; grade <= NBase; grade += 2) { mask |= size_t(1) << grade; }
+        return mask;
+    }();
+    static constexpr size_t kOddGrades = kAllGrades ^ kEvenGrades;
 
 private:
     static std::string get_basis_name(size_t basis_index) {
@@ -120,7 +211,7 @@ private:
         result += "_{";
         bool first = true;
         for (size_t i = 0; i < NBase; ++i) {
-            if (basis_index & (1 << i)) {
+            if (basis_index & (size_t(1) << i)) {
                 if (!first) {
                     result += ",";
                 }
@@ -132,14 +223,456 @@ private:
         return result;
     }
 
-    static this_type pseudo_scalar_inverse() {
-        static const this_type kInverse = []() {
+    // 基a和基b的乘积这一项在kind这种乘法中是否保留
+    static constexpr bool is_contributing(ProductKind kind, size_t idx_a, size_t idx_b) {
+        // 外积要求两边没有共同的基; 内积要求一边的基全在另一边里, 这时结果的阶数正好是|grade_a - grade_b|
+        const size_t common = idx_a & idx_b;
+        switch (kind) {
+            case ProductKind::kInner: return common == idx_a || common == idx_b;
+            case ProductKind::kOuter: return common == 0;
+            default: return true;
+        }
+    }
+
+    // 两边分别只有grades_a, grades_b中的阶数时, kind这种乘法的结果可能出现的阶数
+    static constexpr size_t product_grades(ProductKind kind, size_t grades_a, size_t grades_b) {
+        size_t result = 0;
+        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
+            if (!((grades_a >> std::popcount(idx_a)) & 1)) { continue; }
+            for (size_t idx_b = 0; idx_b < kBasesCnt; ++idx_b) {
+                if (((grades_b >> std::popcount(idx_b)) & 1) && is_contributing(kind, idx_a, idx_b) && !(idx_a & idx_b & kZeroMask)) {
+                    result |= size_t(1) << std::popcount(idx_a ^ idx_b);
+                }
+            }
+        }
+        return result;
+    }
+
+    /* 结果基IdxR中来自左边基IdxA的那一项. 符号是编译期常量(包括两边的逐基变换), 为0或者不保留的项直接消失,
+     * 左右两边的基不在GradesA, GradesB里(调用方保证这些系数是0)的项也一样
+     * 消失的项返回-0.0: x + (-0.0)对所有x都等于x, 编译器可以直接删掉这次加法; x + 0.0在x = -0.0时不成立, 删不掉
+     */
+    template <ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t GradesA, size_t GradesB, size_t IdxR, size_t IdxA>
+    static constexpr T product_term(const this_type& lhs, const this_type& rhs) {
+        constexpr size_t kIdxB = IdxA ^ IdxR;
+        constexpr T kSign = blade_sign(IdxA, kIdxB) * map_sign(MapA, IdxA) * map_sign(MapB, kIdxB);
+        constexpr bool kPresent = ((GradesA >> std::popcount(IdxA)) & 1) && ((GradesB >> std::popcount(kIdxB)) & 1);
+        if constexpr (kSign == T(0) || !is_contributing(Kind, IdxA, kIdxB) || !kPresent) {
+            return T(-0.0);
+        } else if constexpr (kSign == T(1)) {
+            return lhs.data[IdxA] * rhs.data[kIdxB];
+        } else if constexpr (kSign == T(-1)) {
+            return -(lhs.data[IdxA] * rhs.data[kIdxB]);
+        } else {
+            // 度量不是±1时共有的基带着缩放
+            return kSign * lhs.data[IdxA] * rhs.data[kIdxB];
+        }
+    }
+
+    // 左边的基按IdxA % 4分成4路, 第Lane路的和
+    template <
+        ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t GradesA, size_t GradesB, size_t IdxR, size_t Lane, size_t... IdxA
+    >
+    static constexpr T product_lane(
+        const this_type& lhs, const this_type& rhs, std::index_sequence<IdxA...> /*unused*/
+    ) {
+        return (T(-0.0) + ... + (IdxA % 4 == Lane ? product_term<Kind, MapA, MapB, GradesA, GradesB, IdxR, IdxA>(lhs, rhs) : T(-0.0)));
+    }
+
+    // 结果基IdxR的系数: 对所有左边的基求和. 4路分开累加, 加法的依赖链短4倍
+    template <ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t GradesA, size_t GradesB, size_t IdxR, size_t... IdxA>
+    static constexpr T product_blade(
+        const this_type& lhs, const this_type& rhs, std::index_sequence<IdxA...> seq
+    ) {
+        return (product_lane<Kind, MapA, MapB, GradesA, GradesB, IdxR, 0>(lhs, rhs, seq)
+            + product_lane<Kind, MapA, MapB, GradesA, GradesB, IdxR, 1>(lhs, rhs, seq))
+            + (product_lane<Kind, MapA, MapB, GradesA, GradesB, IdxR, 2>(lhs, rhs, seq)
+            + product_lane<Kind, MapA, MapB, GradesA, GradesB, IdxR, 3>(lhs, rhs, seq));
+    }
+
+    /* 展开后的乘法: 对每个结果基分别求和, 没有分支也没有查表
+     * 只计算Grades中的基, 其余直接为0; Scaled时结果再乘以scale.
+     * 调用方知道两边只有GradesA, GradesB中的阶数时(见product_by_grades), 其余的项和结果中不会出现的阶数都不生成代码
+     */
+    template <
+        ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t Grades, bool Scaled,
+        size_t GradesA = kAllGrades, size_t GradesB = kAllGrades, size_t... IdxR
+    >
+    static constexpr this_type product_unrolled(
+        const this_type& lhs, const this_type& rhs, T scale, std::index_sequence<IdxR...> /*unused*/
+    ) {
+        constexpr auto kBlades = std::make_index_sequence<kBasesCnt>{};
+        constexpr size_t kOutGrades = Grades & product_grades(Kind, GradesA, GradesB);
+        this_type result;
+        T* out = result.data.data();
+        ([&] {
+            if constexpr ((kOutGrades >> std::popcount(IdxR)) & 1) {
+                out[IdxR] = product_blade<Kind, MapA, MapB, GradesA, GradesB, IdxR>(lhs, rhs, kBlades);
+                if constexpr (Scaled) { out[IdxR] *= scale; }
+            }
+        }(), ...);
+        constexpr std::uint64_t kOutBlades = grade_blades(kOutGrades);
+        result.data.restrict_mask(kOutBlades);
+        return result;
+    }
+
+    /* 按从大到小的顺序对mask的每个子集(包括mask本身和0)调用func
+     * 内积/外积/regressive积中和一个基配得上的另一个基都是某个掩码的子集(或者再并上固定的基), 直接枚举,
+     * n个基时每种乘法只有3^n项而不是4^n项
+     */
+    template <typename Func>
+    static constexpr void for_each_submask(size_t mask, Func&& func) {
+        for (size_t sub = mask;; sub = (sub - 1) & mask) {
+            func(sub);
+            if (sub == 0) { break; }
+        }
+    }
+
+    // 逐基变换和缩放, 不展开的乘法要先把输入变换好
+    template <BladeMap Map>
+    static this_type apply_map(const this_type& val) {
+        this_type result;
+        T* out = result.data.data();
+        for (size_t i = 0; i < kBasesCnt; ++i) { out[i] = map_sign(Map, i) * val.data[i]; }
+        narrow(result, val.blade_mask());
+        return result;
+    }
+
+    /* 不展开的乘法, 基数较多时使用
+     * 外层是左边的基a, 内层按结果基r顺序累加, 每次迭代互不依赖; 符号只是一次popcount
+     * 几何积把r的低3位拆出来: 这部分的符号对同一个a是固定的8个数, 高位的符号每8项才算一次
+     * 内积/外积只枚举和a配得上的b(见for_each_submask), 不用遍历所有b再筛掉
+     */
+    template <ProductKind Kind>
+    static this_type product_loop(const this_type& lhs, const this_type& rhs) {
+        constexpr size_t kBlock = 8;
+        this_type result;
+        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
+            if (lhs.data[idx_a] == 0) { continue;}  // 0乘任何数都是0, 跳过
+            const size_t mask = flip_mask(idx_a);
+            const auto add_term = [&](size_t idx_b) {
+                if (idx_a & idx_b & kZeroMask) { return; }
+                const T sign = std::popcount(idx_b & mask) % 2 == 0 ? T(1) : T(-1);
+                result.data[idx_a ^ idx_b] += sign * metric_scale(idx_a & idx_b) * lhs.data[idx_a] * rhs.data[idx_b];
+            };
+            if constexpr (Kind == ProductKind::kOuter) {
+                // 外积: b和a没有共同的基, 即b是a的补集的子集
+                for_each_submask((kBasesCnt - 1) ^ idx_a, add_term);
+            } else if constexpr (Kind == ProductKind::kInner) {
+                // 内积: b是a的子集, 或者b = a | s, s是补集的非空子集
+                for_each_submask(idx_a, add_term);
+                for_each_submask((kBasesCnt - 1) ^ idx_a, [&](size_t extra) {
+                    if (extra != 0) { add_term(idx_a | extra); }
+                });
+            } else if constexpr (kZeroMask == 0 && kUnitMetric && kBasesCnt >= kBlock) {
+                const size_t low_a = idx_a % kBlock;
+                std::array<T, kBlock> low_terms{};
+                for (size_t low = 0; low < kBlock; ++low) {
+                    const bool negative = std::popcount((low_a ^ low) & mask) % 2 != 0;
+                    low_terms[low] = negative ? -lhs.data[idx_a] : lhs.data[idx_a];
+                }
+                for (size_t high_r = 0; high_r < kBasesCnt; high_r += kBlock) {
+                    const size_t high_b = (idx_a ^ high_r) & ~(kBlock - 1);
+                    const T sign = std::popcount(high_b & mask) % 2 == 0 ? T(1) : T(-1);
+                    const T* rhs_block = rhs.data.data() + high_b;
+                    T* out = result.data.data() + high_r;
+                    for (size_t low = 0; low < kBlock; ++low) {
+                        out[low] += sign * low_terms[low] * rhs_block[low_a ^ low];
+                    }
+                }
+            } else {
+                for (size_t idx_r = 0; idx_r < kBasesCnt; ++idx_r) { add_term(idx_a ^ idx_r); }
+            }
+        }
+        return result;
+    }
+
+    // 按阶数排好的基: kGradeBlades[kGradeOffsets[k], kGradeOffsets[k + 1])是所有k阶的基, 同阶的从小到大
+    static constexpr std::array<size_t, NBase + 2> kGradeOffsets = [] {
+        std::array<size_t, NBase + 2> offsets{};
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { ++offsets[std::popcount(idx) + 1]; }
+        for (size_t grade = 1; grade < NBase + 2; ++grade) { offsets[grade] += offsets[grade - 1]; }
+        return offsets;
+    }();
+    static constexpr std::array<size_t, kBasesCnt> kGradeBlades = [] {
+        std::array<size_t, kBasesCnt> blades{};
+        std::array<size_t, NBase + 2> next = kGradeOffsets;
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { blades[next[std::popcount(idx)]++] = idx; }
+        return blades;
+    }();
+
+    // 每个基的flip_mask, 稀疏乘法里查表
+    static constexpr std::array<size_t, kBasesCnt> kFlipMasks = [] {
+        std::array<size_t, kBasesCnt> masks{};
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { masks[idx] = flip_mask(idx); }
+        return masks;
+    }();
+
+    // 非零系数的基, 从小到大
+    struct NonzeroBlades {
+        std::array<size_t, kBasesCnt> idx;
+        size_t count = 0;
+    };
+
+    /* 两边的非零项数之积不超过这个值时走稀疏乘法. 稠密的乘法(展开或SIMD)不管输入是什么都要算Grades中每个基的kBasesCnt项,
+     * 稀疏乘法每项多一次popcount和一次不连续的写. 按阶数分好类的输入已经在product_by_grades里处理了, 到这里的是阶数混杂的;
+     * 6个基时实测稀疏乘法每项约4 ns, 稠密的乘法约500 ns, 两边各13项(169项)时持平, 所以所有阶数时取128项
+     */
+    static constexpr size_t sparse_terms(size_t grades) {
+        size_t blades = 0;
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { blades += (grades >> std::popcount(idx)) & 1; }
+        return kBasesCnt * blades / 32;
+    }
+
+    /* 值得走稀疏乘法时把非零的基填进blades_a, blades_b并返回true
+     * 基数不超过6时先看data维护的掩码数个数, 稠密的输入不用建列表.
+     * 不展开的循环每项的代价和稀疏乘法差不多, 而且已经跳过了左边的0, 所以只看右边够不够稀疏
+     */
+    template <size_t Grades>
+    static bool sparse_blades(
+        const this_type& lhs, const this_type& rhs, NonzeroBlades& blades_a, NonzeroBlades& blades_b
+    ) {
+        if constexpr (kBasesCnt <= 64) {
+            constexpr size_t kSparseTerms = sparse_terms(Grades);
+            // 结果只有几个基时(比如norm_squared)稠密的乘法本身就很便宜, 连数非零项都不划算
+            if constexpr (kSparseTerms < kBasesCnt) { return false; }
+            const std::uint64_t mask_a = lhs.data.mask();
+            const std::uint64_t mask_b = rhs.data.mask();
+            if (size_t(std::popcount(mask_a)) * size_t(std::popcount(mask_b)) > kSparseTerms) { return false; }
+            for (std::uint64_t bits = mask_a; bits != 0; bits &= bits - 1) { blades_a.idx[blades_a.count++] = std::countr_zero(bits); }
+            for (std::uint64_t bits = mask_b; bits != 0; bits &= bits - 1) { blades_b.idx[blades_b.count++] = std::countr_zero(bits); }
+        } else {
+            for (size_t i = 0; i < kBasesCnt; ++i) {
+                blades_a.idx[blades_a.count] = i;
+                blades_a.count += lhs.data[i] != T(0);
+                blades_b.idx[blades_b.count] = i;
+                blades_b.count += rhs.data[i] != T(0);
+            }
+        }
+        return kBasesCnt <= 64 || blades_b.count * 4 <= kBasesCnt * 3;
+    }
+
+    /* 稀疏的乘法: 只遍历两边非零的基, 矢量 * 旋量这种输入只有几十到几百项
+     * 符号用位运算现算, 逐基变换和缩放乘在左边的系数上, 结果不在Grades里的项跳过
+     */
+    template <ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t Grades>
+    static this_type product_sparse(
+        const this_type& lhs, const this_type& rhs, const NonzeroBlades& blades_a, const NonzeroBlades& blades_b, T scale
+    ) {
+        this_type result;
+        for (size_t i = 0; i < blades_a.count; ++i) {
+            const size_t idx_a = blades_a.idx[i];
+            const size_t mask = kFlipMasks[idx_a];
+            const T coeff_a = map_sign(MapA, idx_a) * scale * lhs.data[idx_a];
+            for (size_t j = 0; j < blades_b.count; ++j) {
+                const size_t idx_b = blades_b.idx[j];
+                const size_t idx_r = idx_a ^ idx_b;
+                if (!is_contributing(Kind, idx_a, idx_b)) { continue; }
+                if constexpr (Grades != kAllGrades) {
+                    if (!((Grades >> std::popcount(idx_r)) & 1)) { continue; }
+                }
+                if constexpr (kZeroMask != 0) {
+                    if (idx_a & idx_b & kZeroMask) { continue; }
+                }
+                const T sign = std::popcount(idx_b & mask) % 2 == 0 ? T(1) : T(-1);
+                result.data[idx_r] += sign * metric_scale(idx_a & idx_b) * map_sign(MapB, idx_b) * coeff_a * rhs.data[idx_b];
+            }
+        }
+        return result;
+    }
+
+    // 阶数的掩码grades中所有基的掩码
+    static constexpr std::uint64_t grade_blades(size_t grades) requires (kBasesCnt <= 64) {
+        std::uint64_t mask = 0;
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) {
+            if ((grades >> std::popcount(idx)) & 1) { mask |= std::uint64_t(1) << idx; }
+        }
+        return mask;
+    }
+
+    // 掩码为mask的多重向量属于哪一类: 0是一般的, 否则是kVectorGrades, kEvenGrades或kOddGrades
+    static constexpr size_t grade_class(std::uint64_t mask) requires (kBasesCnt <= 64) {
+        if ((mask & ~grade_blades(kVectorGrades)) == 0) { return kVectorGrades; }
+        if ((mask & ~grade_blades(kEvenGrades)) == 0) { return kEvenGrades; }
+        if ((mask & ~grade_blades(kOddGrades)) == 0) { return kOddGrades; }
+        return 0;
+    }
+
+    /* 两边都只有矢量/偶数阶/奇数阶时(矢量 * 旋量, 旋量 * 旋量, 夹心积的中间结果)按阶数走展开的乘法,
+     * 编译期只生成两边阶数之间的项: 矢量 * 旋量是6 * 32项, 旋量 * 旋量是32 * 32项, 稠密的乘法是64 * 64项.
+     * 阶数看data维护的掩码, 不用现数非零项. 只处理几何积, 都不是这几类时返回false
+     */
+    template <ProductKind Kind, BladeMap MapA, BladeMap MapB, size_t Grades, bool Scaled>
+    static bool product_by_grades(const this_type& lhs, const this_type& rhs, T scale, this_type& result) {
+        if constexpr (Kind == ProductKind::kGeometric && kUnrolled) {
+            const size_t class_a = grade_class(lhs.data.mask());
+            const size_t class_b = grade_class(rhs.data.mask());
+            if (class_a == 0 || class_b == 0) { return false; }
+            constexpr auto kSeq = std::make_index_sequence<kBasesCnt>{};
+            const auto dispatch = [&]<size_t GradesA>() {
+                switch (class_b) {
+                case kVectorGrades:
+                    result = product_unrolled<Kind, MapA, MapB, Grades, Scaled, GradesA, kVectorGrades>(lhs, rhs, scale, kSeq);
+                    break;
+                case kEvenGrades:
+                    result = product_unrolled<Kind, MapA, MapB, Grades, Scaled, GradesA, kEvenGrades>(lhs, rhs, scale, kSeq);
+                    break;
+                default:
+                    result = product_unrolled<Kind, MapA, MapB, Grades, Scaled, GradesA, kOddGrades>(lhs, rhs, scale, kSeq);
+                    break;
+                }
+            };
+            switch (class_a) {
+            case kVectorGrades: dispatch.template operator()<kVectorGrades>(); break;
+            case kEvenGrades: dispatch.template operator()<kEvenGrades>(); break;
+            default: dispatch.template operator()<kOddGrades>(); break;
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    // 稠密的乘法写过所有系数, 按实际的非零项收紧掩码(一次SIMD比较), 后面的乘法才能按阶数或稀疏的算法走
+    static void tighten(this_type& result) {
+        if constexpr (kTracked) { result.data.restrict_mask(result.nonzero_mask()); }
+    }
+
+    // 逐基的运算写过所有系数, 结果只可能在mask里的基上非零(比如两边掩码的并), 掩码收紧到mask
+    static void narrow(this_type& result, std::uint64_t mask) {
+        if constexpr (kTracked) { result.data.restrict_mask(mask); }
+    }
+
+    template <ProductKind Kind, BladeMap MapA = BladeMap::kIdentity, BladeMap MapB = BladeMap::kIdentity>
+    static this_type product(const this_type& lhs, const this_type& rhs) {
+        if (this_type result; product_by_grades<Kind, MapA, MapB, kAllGrades, false>(lhs, rhs, T(1), result)) {
+            return result;
+        }
+        NonzeroBlades blades_a;
+        NonzeroBlades blades_b;
+        if (sparse_blades<kAllGrades>(lhs, rhs, blades_a, blades_b)) {
+            return product_sparse<Kind, MapA, MapB, kAllGrades>(lhs, rhs, blades_a, blades_b, T(1));
+        }
+        if constexpr (Kind == ProductKind::kGeometric && ga_simd::has_product<this_type>()) {
             this_type result;
-            result.data[kBasesCnt-1] = 1;
+            ga_simd::geometric_product<this_type, MapA, MapB>(lhs.data.data(), rhs.data.data(), result.data.data());
+            tighten(result);
+            return result;
+        } else if constexpr (kUnrolled) {
+            this_type result = product_unrolled<Kind, MapA, MapB, kAllGrades, false>(lhs, rhs, T(1), std::make_index_sequence<kBasesCnt>{});
+            tighten(result);
             return result;
-        }().inverse();
+        } else if constexpr (MapA == BladeMap::kIdentity && MapB == BladeMap::kIdentity) {
+            return product_loop<Kind>(lhs, rhs);
+        } else {
+            return product_loop<Kind>(apply_map<MapA>(lhs), apply_map<MapB>(rhs));
+        }
+    }
 
-        return kInverse;
+    // 反转的符号: (-1)^{grade(grade-1)/2}
+    static constexpr T reverse_sign(size_t idx) {
+        const auto grade = std::popcount(idx);
+        return (grade % 4 == 0 || grade % 4 == 1) ? T(1) : T(-1);
+    }
+
+    // <e_i e_i>_0: 基i自己的平方, 标量积只有这些项
+    static constexpr std::array<T, kBasesCnt> kSquareSigns = [] {
+        std::array<T, kBasesCnt> result{};
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { result[idx] = blade_sign(idx, idx); }
+        return result;
+    }();
+
+    // <e_i ~e_i>_0, 反转的符号并进去以后就是模长平方的每一项的系数
+    static constexpr std::array<T, kBasesCnt> kNormSigns = [] {
+        std::array<T, kBasesCnt> result{};
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { result[idx] = blade_sign(idx, idx) * reverse_sign(idx); }
+        return result;
+    }();
+
+    // 系数的平方和(欧氏意义下的模长平方), 不管度量是什么都非负
+    static T squared_sum(const this_type& val) {
+        std::array<T, 4> lanes{};
+        for (size_t idx = 0; idx < kBasesCnt; ++idx) { lanes[idx % 4] += val.data[idx] * val.data[idx]; }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    template <size_t... Idx>
+    static constexpr this_type reverse_unrolled(
+        const this_type& val, std::index_sequence<Idx...> /*unused*/
+    ) {
+        this_type result;
+        T* out = result.data.data();
+        ((out[Idx] = reverse_sign(Idx) > T(0) ? val.data[Idx] : -val.data[Idx]), ...);
+        narrow(result, val.blade_mask());
+        return result;
+    }
+
+    /* dual(e_a) = e_a I^{-1} = kDualSigns[a] e_{a的补集}. a总是I的子集, 内积就是几何积, 只剩一个符号
+     * I^{-1} = I / kPseudoscalarSquare, 度量不是±1时这个"符号"也带缩放
+     */
+    static constexpr std::array<T, kBasesCnt> kDualSigns = [] {
+        std::array<T, kBasesCnt> signs{};
+        // 伪标量平方为0时没有dual, 表留空(dual/regressive里有static_assert)
+        if (kPseudoscalarSquare != T(0)) {
+            for (size_t idx = 0; idx < kBasesCnt; ++idx) { signs[idx] = blade_sign(idx, kBasesCnt - 1) / kPseudoscalarSquare; }
+        }
+        return signs;
+    }();
+
+    /* regressive积 dual(dual(e_a) ^ dual(e_b))中基a, b这一项的系数. 只有a | b是全集(两边的补集不相交)时外积不为0,
+     * 结果的基是a & b. 补集不相交, 外积的符号只有交换次数, 没有度量
+     */
+    static constexpr T regressive_sign(size_t idx_a, size_t idx_b) {
+        const size_t dual_a = (kBasesCnt - 1) ^ idx_a;
+        const size_t dual_b = (kBasesCnt - 1) ^ idx_b;
+        const T sign = std::popcount(dual_b & kFlipMasks[dual_a]) % 2 == 0 ? T(1) : T(-1);
+        return kDualSigns[idx_a] * kDualSigns[idx_b] * sign * kDualSigns[dual_a | dual_b];
+    }
+
+    /* 结果基IdxR中来自左边基IdxA的regressive项: IdxA必须包含IdxR, 右边的基是IdxA的补集再并上IdxR
+     * 不是这种形式的IdxA返回-0.0, 同product_term
+     */
+    template <size_t IdxR, size_t IdxA>
+    static constexpr T regressive_term(const this_type& lhs, const this_type& rhs) {
+        constexpr size_t kIdxB = ((kBasesCnt - 1) ^ IdxA) | IdxR;
+        if constexpr ((IdxA & IdxR) != IdxR || regressive_sign(IdxA, kIdxB) == T(0)) {
+            return T(-0.0);
+        } else {
+            return regressive_sign(IdxA, kIdxB) * lhs.data[IdxA] * rhs.data[kIdxB];
+        }
+    }
+
+    template <size_t IdxR, size_t Lane, size_t... IdxA>
+    static constexpr T regressive_lane(
+        const this_type& lhs, const this_type& rhs, std::index_sequence<IdxA...> /*unused*/
+    ) {
+        return (T(-0.0) + ... + (IdxA % 4 == Lane ? regressive_term<IdxR, IdxA>(lhs, rhs) : T(-0.0)));
+    }
+
+    // 展开的regressive积: 结果基r只有2^{n - grade(r)}项, 6个基一共3^6 = 729项(几何积是4096项)
+    template <size_t... IdxR>
+    static constexpr this_type regressive_unrolled(
+        const this_type& lhs, const this_type& rhs, std::index_sequence<IdxR...> /*unused*/
+    ) {
+        constexpr auto kBlades = std::make_index_sequence<kBasesCnt>{};
+        this_type result;
+        ((result.data[IdxR] = (regressive_lane<IdxR, 0>(lhs, rhs, kBlades) + regressive_lane<IdxR, 1>(lhs, rhs, kBlades))
+            + (regressive_lane<IdxR, 2>(lhs, rhs, kBlades) + regressive_lane<IdxR, 3>(lhs, rhs, kBlades))), ...);
+        return result;
+    }
+
+    // 不展开的regressive积: 对每个非零的a, b取遍a的补集并上a的子集s, 结果的基就是s
+    static this_type regressive_loop(const this_type& lhs, const this_type& rhs) {
+        this_type result;
+        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
+            if (lhs.data[idx_a] == 0) { continue; }
+            const size_t complement = (kBasesCnt - 1) ^ idx_a;
+            for_each_submask(idx_a, [&](size_t idx_r) {
+                const size_t idx_b = complement | idx_r;
+                result.data[idx_r] += regressive_sign(idx_a, idx_b) * lhs.data[idx_a] * rhs.data[idx_b];
+            });
+        }
+        return result;
     }
 
 public:
@@ -153,18 +686,22 @@ public:
     // 加法
     this_type operator+(const this_type& other) const {
         this_type result;
+        T* out = result.data.data();
         for (size_t i = 0; i < kBasesCnt; ++i) {
-            result.data[i] = data[i] + other.data[i];
+            out[i] = data[i] + other.data[i];
         }
+        narrow(result, blade_mask() | other.blade_mask());
         return result;
     }
 
     // 取负
     this_type operator-() const {
         this_type result;
+        T* out = result.data.data();
         for (size_t i = 0; i < kBasesCnt; ++i) {
-            result.data[i] = -data[i];
+            out[i] = -data[i];
         }
+        narrow(result, blade_mask());
         return result;
     }
 
@@ -173,28 +710,91 @@ public:
         return *this + (-other);
     }
 
-    // 几何积
-    [[nodiscard]] this_type operator*(const this_type& other) const {
-        this_type result;
-        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
-            if (data[idx_a] == 0) { continue;}  // 0乘任何数都是0, 跳过
-            for (size_t idx_b = 0; idx_b < kBasesCnt; ++idx_b) {
-                if (other.data[idx_b] == 0) { continue; }  // 同上
-                const std::pair<T, size_t>& product = kMulTable[idx_a][idx_b];
-                T sign = product.first;
+    /* 融合的乘法: <map_a(lhs) * map_b(rhs)>_{Grades} * scale, Grades是阶数的掩码(第k位表示k阶)
+     * 逐基的变换并进编译期的符号, 缩放和取阶数在写结果时一起做, 中间不产生临时的多重向量.
+     * 展开的版本只计算Grades里的基, 所以<A ~A>_0这种只要一个系数的乘法很便宜
+     */
+    template <
+        ProductKind Kind,
+        BladeMap MapA = BladeMap::kIdentity,
+        BladeMap MapB = BladeMap::kIdentity,
+        size_t Grades = kAllGrades
+    >
+    [[nodiscard]] static this_type fused_product(const this_type& lhs, const this_type& rhs, T scale = T(1)) {
+        if (this_type result; product_by_grades<Kind, MapA, MapB, Grades, true>(lhs, rhs, scale, result)) {
+            return result;
+        }
+        NonzeroBlades blades_a;
+        NonzeroBlades blades_b;
+        if (sparse_blades<Grades>(lhs, rhs, blades_a, blades_b)) {
+            return product_sparse<Kind, MapA, MapB, Grades>(lhs, rhs, blades_a, blades_b, scale);
+        }
+        if constexpr (Kind == ProductKind::kGeometric && ga_simd::has_product<this_type>() && Grades == kAllGrades) {
+            this_type result;
+            ga_simd::geometric_product<this_type, MapA, MapB, true>(
+                lhs.data.data(), rhs.data.data(), result.data.data(), scale
+            );
+            tighten(result);
+            return result;
+        } else if constexpr (kUnrolled) {
+            this_type result = product_unrolled<Kind, MapA, MapB, Grades, true>(lhs, rhs, scale, std::make_index_sequence<kBasesCnt>{});
+            tighten(result);
+            return result;
+        } else {
+            this_type result = product<Kind, MapA, MapB>(lhs, rhs);
+            for (size_t i = 0; i < kBasesCnt; ++i) {
+                result.data[i] = (Grades >> std::popcount(i)) & 1 ? result.data[i] * scale : T(0);
+            }
+            return result;
+        }
+    }
+
+    /* 非零系数的位掩码, 第i位表示data[i] != 0, 现算(一次SIMD比较). 乘法选算法看的是data.mask(),
+     * 那是写入时维护的上界, 不用每次现算; 这里是精确值. 基数不超过6的代数一个64位整数就放得下
+     */
+    [[nodiscard]] std::uint64_t nonzero_mask() const requires (kBasesCnt <= 64) {
+        return ga_simd::nonzero_mask<T, kBasesCnt>(data.data());
+    }
+
+    // 可能非零的基的掩码(data维护的上界), 不维护掩码的代数返回全1
+    [[nodiscard]] std::uint64_t blade_mask() const {
+        if constexpr (kTracked) {
+            return data.mask();
+        } else {
+            return ~std::uint64_t(0);
+        }
+    }
 
-                result.data[product.second] += sign * data[idx_a] * other.data[idx_b];
+    // 掩码为mask_a, mask_b的两个多重向量做kind乘法, 结果中可能非零的基. 只是上界, 各项也可能正好抵消
+    [[nodiscard]] static constexpr std::uint64_t product_mask(
+        ProductKind kind, std::uint64_t mask_a, std::uint64_t mask_b
+    ) requires (kBasesCnt <= 64) {
+        std::uint64_t result = 0;
+        for (std::uint64_t bits_a = mask_a; bits_a != 0; bits_a &= bits_a - 1) {
+            const size_t idx_a = std::countr_zero(bits_a);
+            for (std::uint64_t bits_b = mask_b; bits_b != 0; bits_b &= bits_b - 1) {
+                const size_t idx_b = std::countr_zero(bits_b);
+                if (is_contributing(kind, idx_a, idx_b) && !(idx_a & idx_b & kZeroMask)) {
+                    result |= std::uint64_t(1) << (idx_a ^ idx_b);
+                }
             }
         }
         return result;
     }
 
+    // 几何积
+    [[nodiscard]] this_type operator*(const this_type& other) const {
+        return product<ProductKind::kGeometric>(*this, other);
+    }
+
     // 乘以系数
     [[nodiscard]] this_type operator*(T scalar) const {
         this_type result;
+        T* out = result.data.data();
         for (size_t i = 0; i < kBasesCnt; ++i) {
-            result.data[i] = data[i] * scalar;
+            out[i] = data[i] * scalar;
         }
+        narrow(result, blade_mask());
         return result;
     }
 
@@ -250,12 +850,10 @@ public:
     // grade projection运算符. <A>_k 是提取A的k-向量部分
     [[nodiscard]] this_type grade_projection(size_t grade) const {
         this_type result;
-        for (size_t i = 0; i < kBasesCnt; ++i) {
-            if (std::popcount(i) == grade) {
-                result.data[i] = data[i];
-            } else {
-                result.data[i] = T(0);
-            }
+        if (grade > NBase) { return result; }
+        // 只拷贝k阶的基, 其余保持0
+        for (size_t slot = kGradeOffsets[grade]; slot < kGradeOffsets[grade + 1]; ++slot) {
+            result.data[kGradeBlades[slot]] = data[kGradeBlades[slot]];
         }
         return result;
     }
@@ -263,29 +861,19 @@ public:
     // 反转：反转所有基向量的顺序
     // 对于k-向量的reverse为(-1)^{k(k-1)/2}
     [[nodiscard]] this_type reverse() const {
-        this_type result;
-
-        for (size_t i = 0; i < kBasesCnt; ++i) {
-            if (data[i] == 0) { continue; }
-
-            // 计算阶数grade（二进制表示中1的个数）
-            size_t grade = std::popcount(i);
-
-            // 反转运算的符号：(-1)^{grade(grade-1)/2}
-            T sign = (grade % 4 == 0 || grade % 4 == 1) ? T(1) : T(-1);
-
-            // 应用符号
-            result.data[i] = sign * data[i];
-        }
+        return reverse_unrolled(*this, std::make_index_sequence<kBasesCnt>{});
+    }
 
-        return result;
+    /* 标量积 <A B>_0. 只有同一个基的两项乘起来才落在标量上, 所以是kBasesCnt项的点积,
+     * 不需要走完整的乘法
+     */
+    [[nodiscard]] T scalar_product(const this_type& other) const {
+        return ga_simd::weighted_dot<T, kBasesCnt>(kSquareSigns.data(), data.data(), other.data.data());
     }
 
-    // 模长的平方
+    // 模长的平方: <A ~A>_0, 同样是点积, 反转的符号已经并进kNormSigns
     [[nodiscard]] T norm_squared() const {
-        this_type rev = this->reverse();
-        this_type product = *this * rev;
-        return product.data[0];  // 标量部分
+        return ga_simd::weighted_dot<T, kBasesCnt>(kNormSigns.data(), data.data(), data.data());
     }
 
     // 模长
@@ -317,19 +905,21 @@ public:
         return result;
     }
 
-    // 逆: A^{-1} = reverse(A) / (A * reverse(A)). 这里不处理除0错误
+    // 逆: A^{-1} = reverse(A) / (A * reverse(A)), 只对versor成立. 这里不处理除0错误
     [[nodiscard]] this_type inverse() const {
-        T norm_squared = this->norm_squared();
-
-        this_type rev = this->reverse();
-        this_type result;
+        return versor_inverse();
+    }
 
-        T inv_n2 = T(1) / norm_squared;
-        for (size_t i = 0; i < kBasesCnt; ++i) {
-            result.data[i] = rev.data[i] * inv_n2;
+    /* versor的逆 ~V / <V ~V>_0. Unit为true时调用方保证<V ~V>_0 = 1(比如归一化过的旋量),
+     * 逆就是反转, 省掉求模长和除法
+     */
+    template <bool Unit = false>
+    [[nodiscard]] this_type versor_inverse() const {
+        if constexpr (Unit) {
+            return reverse();
+        } else {
+            return reverse() * (T(1) / norm_squared());
         }
-
-        return result;
     }
 
     // e^A
@@ -340,12 +930,12 @@ public:
         this_type accum = result + term;
 
         for (size_t iteration = 2; iteration <= max_terms; ++iteration) {
-            term = term * (*this) * (T(1.) / T(iteration)); // A^n / n!
+            term = fused_product<ProductKind::kGeometric>(term, *this, T(1.) / T(iteration)); // A^n / n!
             accum = accum + term;
 
-            // 如果收敛
-            T term_norm = term.norm_squared();
-            if (term_norm < T(1e-10)) {
+            // 如果收敛. 用系数的平方和判断: norm_squared各项的符号随阶数和度量变化, 不定号, 可能在项还很大时就提前停下
+            constexpr T kTolerance = std::numeric_limits<T>::epsilon() * std::numeric_limits<T>::epsilon();
+            if (squared_sum(term) <= kTolerance * squared_sum(accum)) {
                 break;
             }
         }
@@ -355,208 +945,43 @@ public:
 
     // 内积. <A>_a dot <B>_b = <AB>_{|a - b|}
     [[nodiscard]] this_type dot(const this_type& other) const {
-        this_type result{};
-
-        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
-            T coeff_a = data[idx_a];
-            if (coeff_a == T(0)) { continue; }
-            auto grade_a = std::popcount(idx_a);
-
-            for (size_t idx_b = 0; idx_b < kBasesCnt; ++idx_b) {
-                T coeff_b = other.data[idx_b];
-                if (coeff_b == T(0)) { continue; }
-                auto grade_b = std::popcount(idx_b);
-
-                const std::pair<T, size_t>& product = kMulTable[idx_a][idx_b];
-                size_t result_idx = product.second;
-                size_t result_grade = std::popcount(result_idx);
-
-                // 保留 |grade_a - grade_b| 阶部分
-                if (result_grade == std::abs(grade_a - grade_b)) {
-                    result.data[result_idx] += product.first * coeff_a * coeff_b;
-                }
-            }
-        }
-        return result;
+        return product<ProductKind::kInner>(*this, other);
     }
 
     // 外积. <A>_a wedge <B>_b = <AB>_{a + b}
     [[nodiscard]] this_type wedge(const this_type& other) const {
-        this_type result{};
-
-        for (size_t idx_a = 0; idx_a < kBasesCnt; ++idx_a) {
-            T coeff_a = data[idx_a];
-            if (coeff_a == T(0)) { continue; }
-            auto grade_a = std::popcount(idx_a);
-
-            for (size_t idx_b = 0; idx_b < kBasesCnt; ++idx_b) {
-                T coeff_b = other.data[idx_b];
-                if (coeff_b == T(0)) { continue; }
-                auto grade_b = std::popcount(idx_b);
-
-                const std::pair<T, size_t>& product = kMulTable[idx_a][idx_b];
-                size_t result_idx = product.second;
-                size_t result_grade = std::popcount(result_idx);
-
-                // 保留 grade_a + grade_b 阶部分
-                if (result_grade == grade_a + grade_b) {
-                    result.data[result_idx] += product.first * coeff_a * coeff_b;
-                }
-            }
-        }
-        return result;
+        return product<ProductKind::kOuter>(*this, other);
     }
 
     // 对偶. dual A = A dot I^{-1}
     [[nodiscard]] this_type dual() const {
         static_assert(kPseudoscalarSquare != 0., "伪标量平方为0时dual函数无定义");
-        return this->dot(pseudo_scalar_inverse());
-    }
-
-    // regressive积. A vee B = dual(dual(A) wedge dual(b))
-    [[nodiscard]] this_type regressive(const this_type& other) const {
-        return (
-            this->dual().wedge(
-                other.dual()
-            )
-        ).dual();
-    }
-};
-
-namespace vga6 {
-    // 六维VGA
-    using ga_type = GeoAlg<double, 6, {-1, -1, -1, -1, -1, -1}>;
-
-    ga_type _vga_log(const ga_type& val) {
-        // 提取标量部分（偶数阶部分）
-        const double scalar = val.data[0];
-
-        // 提取二重向量部分（2-向量）
-        ga_type bivector = val.grade_projection(2);
-
-        // 计算二重向量的模长平方
-        const double b2_norm = bivector.norm_squared();
-
-        if (b2_norm > 0) {
-            // 正常旋转（欧几里得空间）
-            const double theta = 2.0 * std::acos(std::clamp(scalar, -1., 1.));
-            const double scale = theta / std::sin(theta / 2.0);
-            return bivector * (0.5 * scale);
-        }
-        // 双曲旋转（闵可夫斯基空间），这里简化为正常处理
-        const double arg = std::clamp(scalar, -1., 1.);
-        const double theta = 2.0 * std::acosh(arg);
-        const double scale = theta / std::sinh(theta / 2.0);
-        return bivector * (0.5 * scale);
-    }
-
-    ga_type random_rotor() {
-        static std::random_device random_device;
-        static std::mt19937 gen(random_device());
-        static std::uniform_real_distribution<double> dist(-1.0, 1.0);
-        static std::uniform_real_distribution<double> angle_dist(0.0, 2.0 * std::numbers::pi);
-
-        // 生成随机角度
-        double angle = angle_dist(gen);
-
-        // 生成随机的单位二重向量
-        ga_type bivector{};
-
-        // 在6维空间中，有C(6,2)=15个基二重向量
-        // 我们生成15个随机系数，然后归一化
-        double norm_sq = 0.0;
-        for (size_t i = 0; i < ga_type::kBasesCnt; ++i) {
-            if (std::popcount(i) == 2) {  // 只处理二重向量基
-                double coeff = dist(gen);
-                bivector.data[i] = coeff;
-                norm_sq += coeff * coeff;
-            }
+        // 每个基只对应补集上的一项, 不需要真的和I^{-1}相乘
+        this_type result;
+        T* out = result.data.data();
+        for (size_t i = 0; i < kBasesCnt; ++i) {
+            out[(kBasesCnt - 1) ^ i] = kDualSigns[i] * data[i];
         }
-
-        // 归一化二重向量
-        if (norm_sq > 1e-10) {
-            double inv_norm = 1.0 / std::sqrt(norm_sq);
-            for (size_t i = 0; i < ga_type::kBasesCnt; ++i) {
-                if (std::popcount(i) == 2) {
-                    bivector.data[i] *= inv_norm;
-                }
+        if constexpr (kTracked) {
+            // 基i换成补集, 掩码按位倒过来
+            std::uint64_t mask = 0;
+            for (std::uint64_t bits = data.mask(); bits != 0; bits &= bits - 1) {
+                mask |= std::uint64_t(1) << ((kBasesCnt - 1) ^ std::countr_zero(bits));
             }
-        } else {
-            // 如果随机数太小，使用默认二重向量
-            bivector.data[0b000011] = 1.0;  // e_{0,1}
+            result.data.restrict_mask(mask);
         }
-
-        // 计算旋量：exp(angle/2 * bivector)
-        ga_type rotor = (bivector * (angle * 0.5)).exp();
-
-        // 归一化旋量以确保数值稳定性
-        return rotor * (1. / rotor.norm());
-    }
-
-    ga_type rotor_lerp(const ga_type& rotor, double times) {
-        // 实现旋量的球面线性插值（slerp）
-        // slerp(R0, R1, t) = R0 * exp(t * log(R0^{-1} * R1))
-
-        // 单位旋量
-        static const ga_type kIdentityRotor{1.0};
-
-        // 计算相对旋转：R_rel = rotor0^{-1} * rotor
-        // 这里假设从单位旋量插值到目标旋量
-        ga_type r_rel = rotor;  // identity_rotor.inverse() * rotor = rotor
-
-        // 计算相对旋转的对数
-        ga_type log_r_rel = _vga_log(r_rel);
-
-        // 插值：exp(t * log_R_rel)
-        ga_type interpolated = (log_r_rel * times).exp();
-
-        // 归一化结果
-        return interpolated * (1. / interpolated.norm());
-    }
-
-    ga_type rotor_lerp(const ga_type& start, const ga_type& end, double t_val) {
-        t_val = std::clamp(t_val, 0.0, 1.0);
-
-        // 计算相对旋量：end * start^{-1}
-        ga_type start_inv = start.inverse();
-        ga_type relative_rotor = end * start_inv;
-
-        // 计算相对旋量的对数（得到一个二重向量）
-        ga_type log_relative = _vga_log(relative_rotor);
-
-        // 插值：exp(t * log(relative))
-        ga_type interpolated_log = log_relative * t_val;
-        ga_type interpolated_rotor = interpolated_log.exp();
-
-        // 应用插值：start * interpolated_rotor
-        ga_type result = start * interpolated_rotor;
-
-        // 归一化结果以确保数值稳定性
-        double norm = result.norm();
-        result = result * (1.0 / norm);
-
         return result;
     }
 
-    [[nodiscard]] inline float6 to_float6(ga_type val) {
-        return make_float6(
-            val.data[0b000001],
-            val.data[0b000010],
-            val.data[0b000100],
-            val.data[0b001000],
-            val.data[0b010000],
-            val.data[0b100000]
-        );
-    }
-
-    inline ga_type make_ga_point(std::array<double, 6> pos) {
-        ga_type result;
-        result.data[0b000001] = pos[0];
-        result.data[0b000010] = pos[1];
-        result.data[0b000100] = pos[2];
-        result.data[0b001000] = pos[3];
-        result.data[0b010000] = pos[4];
-        result.data[0b100000] = pos[5];
-        return result;
+    /* regressive积. A vee B = dual(dual(A) wedge dual(b))
+     * 直接按基展开: 只有a | b是全集的(a, b)有贡献, 符号在regressive_sign里一次算好, 不用做三次dual和一次外积
+     */
+    [[nodiscard]] this_type regressive(const this_type& other) const {
+        static_assert(kPseudoscalarSquare != 0., "伪标量平方为0时regressive函数无定义");
+        if constexpr (kUnrolled) {
+            return regressive_unrolled(*this, other, std::make_index_sequence<kBasesCnt>{});
+        } else {
+            return regressive_loop(*this, other);
+        }
     }
-}  // namespace vga6
+};
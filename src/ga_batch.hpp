@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ga.hpp"
+#include "ga_expr.hpp"
+#include "ga_graded.hpp"
+
+/* 结构数组(SoA)形式的多重向量数组
+ * 每个基的系数单独连续存放, 对所有元素做同一个运算时最内层循环沿着元素走, 编译器可以直接向量化;
+ * 外层再按段分给多个线程. 用来一次处理几百万个点, 比如旋转6维点云
+ */
+namespace ga_batch {
+// 每个线程至少处理这么多个元素, 太少的话开线程不划算
+constexpr size_t kMinChunk = 16384;
+// 线程内再按这个大小分块, 一块的输入输出都能留在L1/L2里
+constexpr size_t kBlock = 256;
+
+/* 把[0, count)分段并行执行func(begin, end), 返回时所有段都已完成
+ * 每段至少min_chunk个元素; 单个元素很贵时(比如每帧一次旋量插值)可以传很小的值
+ */
+template <typename Func>
+void parallel_for(size_t count, size_t min_chunk, Func&& func) {
+    const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t threads = std::clamp<size_t>(count / std::max<size_t>(1, min_chunk), 1, hardware);
+    const size_t chunk = (count + threads - 1) / threads;
+
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+    for (size_t thread = 1; thread < threads; ++thread) {
+        const size_t begin = thread * chunk;
+        const size_t end = std::min(count, begin + chunk);
+        if (begin < end) {
+            workers.emplace_back([&func, begin, end] { func(begin, end); });
+        }
+    }
+    func(0, std::min(count, chunk));
+}  // workers析构时join
+
+template <typename Func>
+void parallel_for(size_t count, Func&& func) {
+    parallel_for(count, kMinChunk, std::forward<Func>(func));
+}
+
+// 外积/内积结果可能的阶数, 规则同GeoAlg::ProductKind
+template <size_t NBase>
+constexpr size_t outer_grades(size_t mask_a, size_t mask_b) {
+    size_t result = 0;
+    for (size_t grade_a = 0; grade_a <= NBase; ++grade_a) {
+        if (!(mask_a & (size_t(1) << grade_a))) { continue; }
+        for (size_t grade_b = 0; grade_a + grade_b <= NBase; ++grade_b) {
+            if (mask_b & (size_t(1) << grade_b)) { result |= size_t(1) << (grade_a + grade_b); }
+        }
+    }
+    return result;
+}
+
+template <size_t NBase>
+constexpr size_t inner_grades(size_t mask_a, size_t mask_b) {
+    size_t result = 0;
+    for (size_t grade_a = 0; grade_a <= NBase; ++grade_a) {
+        if (!(mask_a & (size_t(1) << grade_a))) { continue; }
+        for (size_t grade_b = 0; grade_b <= NBase; ++grade_b) {
+            if (mask_b & (size_t(1) << grade_b)) {
+                result |= size_t(1) << (grade_a > grade_b ? grade_a - grade_b : grade_b - grade_a);
+            }
+        }
+    }
+    return result;
+}
+}  // namespace ga_batch
+
+// count个GradedGeoAlg<GA, GradeMask>, 按基分开存储
+template <typename GA, size_t GradeMask>
+class BatchGeoAlg {
+public:
+    using element_type = GradedGeoAlg<GA, GradeMask>;
+    using value_type = typename GA::value_type;
+    using this_type = BatchGeoAlg<GA, GradeMask>;
+    static constexpr size_t kGradeMask = GradeMask;
+    static constexpr size_t kSize = element_type::kSize;
+
+    BatchGeoAlg()=default;
+
+    explicit BatchGeoAlg(size_t count) {
+        resize(count);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return count_;
+    }
+
+    void resize(size_t count) {
+        count_ = count;
+        for (auto& component : components_) { component.resize(count); }
+    }
+
+    // 第slot个分量(基element_type::kBlades[slot])的所有系数, 连续存放
+    [[nodiscard]] value_type* component(size_t slot) {
+        return components_[slot].data();
+    }
+
+    [[nodiscard]] const value_type* component(size_t slot) const {
+        return components_[slot].data();
+    }
+
+    [[nodiscard]] element_type get(size_t idx) const {
+        element_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = components_[slot][idx]; }
+        return result;
+    }
+
+    void set(size_t idx, const element_type& val) {
+        for (size_t slot = 0; slot < kSize; ++slot) { components_[slot][idx] = val.data[slot]; }
+    }
+
+private:
+    std::array<std::vector<value_type>, kSize> components_{};
+    size_t count_ = 0;
+};
+
+namespace ga_batch {
+template <typename GA>
+using matrix = std::array<std::array<typename GA::value_type, GA::kVectorsCnt>, GA::kVectorsCnt>;
+
+// versor作用在1-向量上的矩阵, 第i列是<V e_i ~V>_1. 每次批量旋转只算一次
+template <typename GA>
+[[nodiscard]] matrix<GA> versor_matrix(const GA& versor) {
+    matrix<GA> result{};
+    for (size_t col = 0; col < GA::kVectorsCnt; ++col) {
+        GA basis;
+        basis.data[size_t(1) << col] = 1;
+        const GA image = (ga_expr::lazy(versor) * basis * ga_expr::lazy(versor).reverse()).grade(1);
+        for (size_t row = 0; row < GA::kVectorsCnt; ++row) { result[col][row] = image.data[size_t(1) << row]; }
+    }
+    return result;
+}
+
+/* out[p] = R points[p] ~R
+ * 三明治积对1-向量是线性的, 先把R换成N x N矩阵, 之后每个点只要N^2次乘加, 沿着点的方向向量化
+ * 每块先算到栈上的临时数组再写回, out和points可以是同一个对象(原地旋转)
+ */
+template <typename GA>
+void apply_rotor(const GA& rotor, const BatchGeoAlg<GA, 0b10>& points, BatchGeoAlg<GA, 0b10>& out) {
+    using T = typename GA::value_type;
+    constexpr size_t kDim = GA::kVectorsCnt;
+    const matrix<GA> mat = versor_matrix(rotor);
+    out.resize(points.size());
+
+    parallel_for(points.size(), [&](size_t begin, size_t end) {
+        std::array<const T*, kDim> input{};
+        std::array<T*, kDim> output{};
+        for (size_t dim = 0; dim < kDim; ++dim) {
+            input[dim] = points.component(dim);
+            output[dim] = out.component(dim);
+        }
+        std::array<std::array<T, kBlock>, kDim> rotated{};
+        for (size_t block = begin; block < end; block += kBlock) {
+            const size_t block_end = std::min(end, block + kBlock);
+            for (size_t row = 0; row < kDim; ++row) {
+                T* dst = rotated[row].data();
+                for (size_t idx = block; idx < block_end; ++idx) {
+                    T sum = 0;
+                    for (size_t col = 0; col < kDim; ++col) { sum += mat[col][row] * input[col][idx]; }
+                    dst[idx - block] = sum;
+                }
+            }
+            for (size_t row = 0; row < kDim; ++row) {
+                std::copy(rotated[row].begin(), rotated[row].begin() + (block_end - block), output[row] + block);
+            }
+        }
+    });
+}
+
+template <typename GA>
+[[nodiscard]] BatchGeoAlg<GA, 0b10> apply_rotor(const GA& rotor, const BatchGeoAlg<GA, 0b10>& points) {
+    BatchGeoAlg<GA, 0b10> out;
+    apply_rotor(rotor, points, out);
+    return out;
+}
+
+namespace detail {
+// 逐元素乘法的一项: out[OutSlot] += sign * a[ASlot] * b[BSlot]
+struct Term {
+    size_t out_slot;
+    size_t a_slot;
+    size_t b_slot;
+    double sign;
+};
+
+// Out = A op B展开后的所有非零项, 编译期算好
+template <typename GA, typename GA::ProductKind Kind, typename A, typename B, typename Out>
+constexpr auto product_terms() {
+    struct Terms {
+        std::array<Term, A::kSize * B::kSize> terms{};
+        size_t count = 0;
+    } result;
+    for (size_t a_slot = 0; a_slot < A::kSize; ++a_slot) {
+        for (size_t b_slot = 0; b_slot < B::kSize; ++b_slot) {
+            const size_t idx_a = A::kBlades[a_slot];
+            const size_t idx_b = B::kBlades[b_slot];
+            const auto grade_a = std::popcount(idx_a);
+            const auto grade_b = std::popcount(idx_b);
+            const auto grade_r = std::popcount(idx_a ^ idx_b);
+            const bool kept = Kind == GA::ProductKind::kOuter ? grade_r == grade_a + grade_b
+                : Kind == GA::ProductKind::kInner ? grade_r == (grade_a > grade_b ? grade_a - grade_b : grade_b - grade_a)
+                : true;
+            const auto sign = static_cast<double>(GA::blade_sign(idx_a, idx_b));
+            const size_t out_slot = Out::kSlots[idx_a ^ idx_b];
+            if (!kept || sign == 0. || out_slot == Out::kSize) { continue; }
+            result.terms[result.count++] = {out_slot, a_slot, b_slot, sign};
+        }
+    }
+    return result;
+}
+
+template <typename GA, typename GA::ProductKind Kind, size_t MaskA, size_t MaskB, size_t OutMask>
+void elementwise_product(
+    const BatchGeoAlg<GA, MaskA>& lhs, const BatchGeoAlg<GA, MaskB>& rhs, BatchGeoAlg<GA, OutMask>& out
+) {
+    using T = typename GA::value_type;
+    using out_type = BatchGeoAlg<GA, OutMask>;
+    static constexpr auto kTerms = product_terms<
+        GA, Kind, GradedGeoAlg<GA, MaskA>, GradedGeoAlg<GA, MaskB>, GradedGeoAlg<GA, OutMask>
+    >();
+    // out先清零再累加, 和输入是同一个对象时会读到改过的值, 这时先算到临时对象里
+    if (static_cast<const void*>(&out) == &lhs || static_cast<const void*>(&out) == &rhs) {
+        BatchGeoAlg<GA, OutMask> temp;
+        elementwise_product<GA, Kind>(lhs, rhs, temp);
+        out = std::move(temp);
+        return;
+    }
+    const size_t count = std::min(lhs.size(), rhs.size());
+    out.resize(count);
+
+    parallel_for(count, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block += kBlock) {
+            const size_t block_end = std::min(end, block + kBlock);
+            for (size_t slot = 0; slot < out_type::kSize; ++slot) {
+                std::fill(out.component(slot) + block, out.component(slot) + block_end, T(0));
+            }
+            for (size_t term = 0; term < kTerms.count; ++term) {
+                const Term& info = kTerms.terms[term];
+                const T sign = static_cast<T>(info.sign);
+                const T* src_a = lhs.component(info.a_slot);
+                const T* src_b = rhs.component(info.b_slot);
+                T* dst = out.component(info.out_slot);
+                for (size_t idx = block; idx < block_end; ++idx) { dst[idx] += sign * src_a[idx] * src_b[idx]; }
+            }
+        }
+    });
+}
+}  // namespace detail
+
+// 逐元素外积 out[p] = lhs[p] ^ rhs[p], out的阶数不够时多出来的部分丢掉
+template <typename GA, size_t MaskA, size_t MaskB, size_t OutMask>
+void wedge(const BatchGeoAlg<GA, MaskA>& lhs, const BatchGeoAlg<GA, MaskB>& rhs, BatchGeoAlg<GA, OutMask>& out) {
+    detail::elementwise_product<GA, GA::ProductKind::kOuter>(lhs, rhs, out);
+}
+
+template <typename GA, size_t MaskA, size_t MaskB>
+[[nodiscard]] auto wedge(const BatchGeoAlg<GA, MaskA>& lhs, const BatchGeoAlg<GA, MaskB>& rhs) {
+    BatchGeoAlg<GA, outer_grades<GA::kVectorsCnt>(MaskA, MaskB)> out;
+    wedge(lhs, rhs, out);
+    return out;
+}
+
+// 逐元素内积 out[p] = lhs[p] . rhs[p]
+template <typename GA, size_t MaskA, size_t MaskB, size_t OutMask>
+void dot(const BatchGeoAlg<GA, MaskA>& lhs, const BatchGeoAlg<GA, MaskB>& rhs, BatchGeoAlg<GA, OutMask>& out) {
+    detail::elementwise_product<GA, GA::ProductKind::kInner>(lhs, rhs, out);
+}
+
+template <typename GA, size_t MaskA, size_t MaskB>
+[[nodiscard]] auto dot(const BatchGeoAlg<GA, MaskA>& lhs, const BatchGeoAlg<GA, MaskB>& rhs) {
+    BatchGeoAlg<GA, inner_grades<GA::kVectorsCnt>(MaskA, MaskB)> out;
+    dot(lhs, rhs, out);
+    return out;
+}
+}  // namespace ga_batch
@@ -0,0 +1,295 @@
+// GeoAlg的微基准测试
+// xmake build ga_bench && xmake run ga_bench
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ga_batch.hpp"
+#include "ga_expr.hpp"
+#include "vga6.hpp"
+
+namespace {
+using ga_type = vga6::ga_type;
+
+// 以前GeoAlg里的乘法表: table[a][b] = {符号, 结果的基}
+template <typename GA>
+const std::vector<std::pair<typename GA::value_type, size_t>>& reference_table() {
+    static const auto kTable = [] {
+        std::vector<std::pair<typename GA::value_type, size_t>> table(GA::kBasesCnt * GA::kBasesCnt);
+        for (size_t idx_a = 0; idx_a < GA::kBasesCnt; ++idx_a) {
+            for (size_t idx_b = 0; idx_b < GA::kBasesCnt; ++idx_b) {
+                table[idx_a * GA::kBasesCnt + idx_b] = {GA::blade_sign(idx_a, idx_b), idx_a ^ idx_b};
+            }
+        }
+        return table;
+    }();
+    return kTable;
+}
+
+// 改动之前的乘法: kBasesCnt^2的循环, 每一项都判断0并查乘法表
+template <typename GA>
+GA reference_product(const GA& lhs, const GA& rhs) {
+    const auto& table = reference_table<GA>();
+    GA result;
+    auto* out = result.data.data();  // 直接写数组, 不在内层循环里维护掩码
+    for (size_t idx_a = 0; idx_a < GA::kBasesCnt; ++idx_a) {
+        if (lhs.data[idx_a] == 0) { continue; }
+        for (size_t idx_b = 0; idx_b < GA::kBasesCnt; ++idx_b) {
+            if (rhs.data[idx_b] == 0) { continue; }
+            const auto& product = table[idx_a * GA::kBasesCnt + idx_b];
+            out[product.second] += product.first * lhs.data[idx_a] * rhs.data[idx_b];
+        }
+    }
+    return result;
+}
+
+template <typename GA>
+GA random_multivector(std::mt19937& gen) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    GA result;
+    for (auto& coeff : result.data) { coeff = dist(gen); }
+    return result;
+}
+
+// 对inputs里相邻的两项做func, 返回每次调用的平均纳秒数
+template <typename GA, typename Func>
+double bench(const char* name, const std::vector<GA>& inputs, Func&& func) {
+    constexpr size_t kRounds = 200;
+    GA sink;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < kRounds; ++round) {
+        for (size_t i = 0; i + 1 < inputs.size(); ++i) {
+            sink = sink + func(inputs[i], inputs[i + 1]);
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double calls = static_cast<double>(kRounds * (inputs.size() - 1));
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / calls;
+    std::printf("%-28s %10.1f ns/op   (sink %g)\n", name, ns, static_cast<double>(sink.data[0]));
+    return ns;
+}
+
+template <typename GA>
+double max_difference(const GA& lhs, const GA& rhs) {
+    double result = 0;
+    for (size_t i = 0; i < GA::kBasesCnt; ++i) {
+        result = std::max(result, static_cast<double>(std::abs(lhs.data[i] - rhs.data[i])));
+    }
+    return result;
+}
+
+// 单精度的稠密乘法, 看每个寄存器多放一倍通道的效果
+void bench_float() {
+    using ga_type_f = vga6::ga_type_f;
+    std::mt19937 gen(7);
+    std::vector<ga_type_f> dense(1024);
+    for (auto& val : dense) { val = random_multivector<ga_type_f>(gen); }
+
+    const double ref = bench("reference  float dense", dense, reference_product<ga_type_f>);
+    const double now = bench("GeoAlg     float dense", dense, [](const ga_type_f& lhs, const ga_type_f& rhs) {
+        return lhs * rhs;
+    });
+    std::printf("speedup float dense: %.2fx (simd: %s)\n", ref / now, ga_simd::has_product<ga_type_f>() ? "yes" : "no");
+}
+
+// 其他维数的代数: 共形5维(3维空间的CGA, 32个基)和8/10维, 都不需要乘法表
+template <typename GA>
+void bench_algebra(const char* name, size_t count) {
+    std::mt19937 gen(11);
+    std::vector<GA> dense(count);
+    for (auto& val : dense) { val = random_multivector<GA>(gen); }
+
+    double error = 0;
+    for (size_t i = 0; i + 1 < dense.size(); ++i) {
+        error = std::max(error, max_difference(dense[i] * dense[i + 1], reference_product<GA>(dense[i], dense[i + 1])));
+    }
+    char label[64];
+    std::snprintf(label, sizeof(label), "reference  %s", name);
+    const double ref = bench(label, dense, reference_product<GA>);
+    std::snprintf(label, sizeof(label), "GeoAlg     %s", name);
+    const double now = bench(label, dense, [](const GA& lhs, const GA& rhs) { return lhs * rhs; });
+    std::printf("speedup %s: %.2fx (max diff %g, table %zu KiB)\n",
+        name, ref / now, error, reference_table<GA>().size() * sizeof(reference_table<GA>()[0]) / 1024);
+
+    // 内积/外积/regressive积只枚举配得上的基, n个基时3^n项
+    std::snprintf(label, sizeof(label), "GeoAlg     %s dot", name);
+    bench(label, dense, [](const GA& lhs, const GA& rhs) { return lhs.dot(rhs); });
+    std::snprintf(label, sizeof(label), "GeoAlg     %s wedge", name);
+    bench(label, dense, [](const GA& lhs, const GA& rhs) { return lhs.wedge(rhs); });
+    std::snprintf(label, sizeof(label), "GeoAlg     %s regressive", name);
+    bench(label, dense, [](const GA& lhs, const GA& rhs) { return lhs.regressive(rhs); });
+}
+
+// 批量旋转/外积/内积, 按每秒处理的点数报告
+void bench_batch() {
+    using point_batch = BatchGeoAlg<ga_type, 0b10>;
+    constexpr size_t kPoints = size_t(1) << 21;
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    point_batch points(kPoints);
+    point_batch others(kPoints);
+    for (size_t dim = 0; dim < 6; ++dim) {
+        for (size_t idx = 0; idx < kPoints; ++idx) {
+            points.component(dim)[idx] = dist(gen);
+            others.component(dim)[idx] = dist(gen);
+        }
+    }
+    const ga_type rotor = vga6::random_rotor();
+
+    const auto measure = [](const char* name, size_t count, auto&& func) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        const auto end = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        std::printf("%-28s %10.2f Mpoints/s\n", name, static_cast<double>(count) / seconds * 1e-6);
+    };
+
+    // 对照: 每个点单独做一次三明治积, 单线程
+    constexpr size_t kScalarPoints = size_t(1) << 15;
+    point_batch rotated(kPoints);
+    measure("GeoAlg     R * v * ~R", kScalarPoints, [&] {
+        for (size_t idx = 0; idx < kScalarPoints; ++idx) {
+            const ga_type point = points.get(idx).to_full();
+            const ga_type image = (ga_expr::lazy(rotor) * point * ga_expr::lazy(rotor).reverse()).grade(1);
+            rotated.set(idx, vga6::vector_type{image});
+        }
+    });
+    measure("ga_batch   apply_rotor", kPoints, [&] { ga_batch::apply_rotor(rotor, points, rotated); });
+
+    double error = 0;
+    for (size_t idx = 0; idx < kScalarPoints; idx += 97) {
+        const ga_type point = points.get(idx).to_full();
+        const ga_type image = rotor * point * rotor.reverse();
+        const vga6::vector_type batched = rotated.get(idx);
+        for (size_t dim = 0; dim < 6; ++dim) {
+            error = std::max(error, std::abs(batched.data[dim] - image.data[size_t(1) << dim]));
+        }
+    }
+    std::printf("max |apply_rotor - sandwich| = %g\n", error);
+
+    BatchGeoAlg<ga_type, 0b100> planes(kPoints);
+    BatchGeoAlg<ga_type, 0b1> products(kPoints);
+    measure("ga_batch   wedge", kPoints, [&] { ga_batch::wedge(points, others, planes); });
+    measure("ga_batch   dot", kPoints, [&] { ga_batch::dot(points, others, products); });
+}
+}  // namespace
+
+int main() {
+    std::mt19937 gen(42);
+    std::vector<ga_type> dense(1024);
+    std::vector<ga_type> rotors(1024);
+    for (auto& val : dense) { val = random_multivector<ga_type>(gen); }
+    for (auto& val : rotors) { val = vga6::random_rotor(); }
+
+    // 先确认结果一致
+    double error = 0;
+    for (size_t i = 0; i + 1 < dense.size(); ++i) {
+        error = std::max(error, max_difference(dense[i] * dense[i + 1], reference_product<ga_type>(dense[i], dense[i + 1])));
+    }
+    std::printf("max |unrolled - reference| = %g\n", error);
+
+    const double ref_dense = bench("reference  dense * dense", dense, reference_product<ga_type>);
+    const double new_dense = bench("GeoAlg     dense * dense", dense, [](const ga_type& lhs, const ga_type& rhs) {
+        return lhs * rhs;
+    });
+    const double ref_rotor = bench("reference  rotor * rotor", rotors, reference_product<ga_type>);
+    const double new_rotor = bench("GeoAlg     rotor * rotor", rotors, [](const ga_type& lhs, const ga_type& rhs) {
+        return lhs * rhs;
+    });
+    bench("GeoAlg     dot", dense, [](const ga_type& lhs, const ga_type& rhs) { return lhs.dot(rhs); });
+    bench("GeoAlg     wedge", dense, [](const ga_type& lhs, const ga_type& rhs) { return lhs.wedge(rhs); });
+    bench("GeoAlg     regressive", dense, [](const ga_type& lhs, const ga_type& rhs) { return lhs.regressive(rhs); });
+    // 稀疏的输入: 1-向量和旋量, 只遍历非零的基
+    std::vector<ga_type> vectors(1024);
+    for (auto& val : vectors) { val = random_multivector<ga_type>(gen).grade_projection(1); }
+    std::vector<ga_type> mixed(1024);
+    for (size_t i = 0; i < mixed.size(); ++i) { mixed[i] = i % 2 == 0 ? vectors[i] : rotors[i]; }
+    double sparse_error = 0;
+    bool mask_covered = true;
+    for (size_t i = 0; i + 1 < mixed.size(); ++i) {
+        const ga_type product = mixed[i] * mixed[i + 1];
+        sparse_error = std::max(sparse_error, max_difference(product, reference_product<ga_type>(mixed[i], mixed[i + 1])));
+        const std::uint64_t predicted = ga_type::product_mask(
+            ga_type::ProductKind::kGeometric, mixed[i].nonzero_mask(), mixed[i + 1].nonzero_mask()
+        );
+        mask_covered = mask_covered && (product.nonzero_mask() & ~predicted) == 0;
+    }
+    std::printf("max |sparse - reference| = %g, product_mask %s\n", sparse_error, mask_covered ? "ok" : "WRONG");
+    const double ref_mixed = bench("reference  vector * rotor", mixed, reference_product<ga_type>);
+    const double new_mixed = bench("GeoAlg     vector * rotor", mixed, [](const ga_type& lhs, const ga_type& rhs) {
+        return lhs * rhs;
+    });
+    bench("GeoAlg     vector ^ vector", vectors, [](const ga_type& lhs, const ga_type& rhs) { return lhs.wedge(rhs); });
+    bench("GeoAlg     vector . vector", vectors, [](const ga_type& lhs, const ga_type& rhs) { return lhs.dot(rhs); });
+    std::printf("speedup vector * rotor: %.2fx\n", ref_mixed / new_mixed);
+    bench("GeoAlg     reverse", dense, [](const ga_type& lhs, const ga_type& /*rhs*/) { return lhs.reverse(); });
+
+    /* 三明治积R v ~R: 直接相乘会产生两个完整的临时值, 第二个乘法要算全部32个奇数阶的基.
+     * 表达式把反转并进乘法, 最后只算1阶; 中间的R v按阶数只算奇数阶(见GeoAlg::product_by_grades).
+     * GradedGeoAlg::sandwich是只存这些阶数的同一个算法, 作为对照
+     * mixed里向量和旋量交替出现, 标量部分不为0的那个是旋量
+     */
+    const double eager_sandwich = bench("eager      R * v * ~R", mixed, [](const ga_type& lhs, const ga_type& rhs) {
+        const ga_type& rotor = lhs.data[0] != 0 ? lhs : rhs;
+        const ga_type& point = lhs.data[0] != 0 ? rhs : lhs;
+        return rotor * point.grade_projection(1) * rotor.reverse();
+    });
+    const double lazy_sandwich = bench("ga_expr    R * v * ~R", mixed, [](const ga_type& lhs, const ga_type& rhs) -> ga_type {
+        const ga_type& rotor = lhs.data[0] != 0 ? lhs : rhs;
+        const ga_type& point = lhs.data[0] != 0 ? rhs : lhs;
+        return (ga_expr::lazy(rotor) * ga_expr::lazy(point).grade(1) * ga_expr::lazy(rotor).reverse()).grade(1);
+    });
+    const double graded_sandwich = bench("graded     R * v * ~R", mixed, [](const ga_type& lhs, const ga_type& rhs) {
+        const ga_type& rotor = lhs.data[0] != 0 ? lhs : rhs;
+        const ga_type& point = lhs.data[0] != 0 ? rhs : lhs;
+        return vga6::rotor_type{rotor}.sandwich(vga6::vector_type{point}).to_full();
+    });
+    // 标量部分只有kBasesCnt项: 完整的乘法再取data[0]和直接点积
+    const double full_norm = bench("reference  (A * ~A)_0", dense, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return ga_type((lhs * lhs.reverse()).data[0]);
+    });
+    const double dot_norm = bench("GeoAlg     norm_squared", dense, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return ga_type(lhs.norm_squared());
+    });
+    bench("GeoAlg     scalar_product", dense, [](const ga_type& lhs, const ga_type& rhs) {
+        return ga_type(lhs.scalar_product(rhs));
+    });
+    bench("GeoAlg     rotor inverse", rotors, [](const ga_type& lhs, const ga_type& /*rhs*/) { return lhs.inverse(); });
+    bench("GeoAlg     unit rotor inverse", rotors, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return lhs.versor_inverse<true>();
+    });
+    std::printf("speedup norm_squared: %.2fx\n", full_norm / dot_norm);
+    std::printf(
+        "speedup sandwich: %.2fx (graded %.2fx)\n", eager_sandwich / lazy_sandwich, eager_sandwich / graded_sandwich
+    );
+
+    std::printf(
+        "speedup dense: %.2fx, rotor: %.2fx (simd: %s)\n",
+        ref_dense / new_dense, ref_rotor / new_rotor, ga_simd::has_product<ga_type>() ? "yes" : "no"
+    );
+
+    // 二重向量的指数: 泰勒级数和不变量分解的闭式解
+    std::vector<ga_type> bivectors(1024);
+    for (auto& val : bivectors) { val = vga6::bivector_type{random_multivector<ga_type>(gen)}.to_full(); }
+    const double taylor_exp = bench("GeoAlg     exp (taylor)", bivectors, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return lhs.exp();
+    });
+    const double closed_exp = bench("vga6       bivector_exp", bivectors, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return vga6::bivector_exp(vga6::bivector_type{lhs}).to_full();
+    });
+    bench("vga6       rotor_log", rotors, [](const ga_type& lhs, const ga_type& /*rhs*/) {
+        return vga6::rotor_log(vga6::rotor_type{lhs}).to_full();
+    });
+    std::printf("speedup exp: %.2fx\n", taylor_exp / closed_exp);
+
+    bench_float();
+    bench_batch();
+
+    bench_algebra<GeoAlg<double, 5, {1, 1, 1, 1, -1}>>("cga 5d", 1024);
+    bench_algebra<GeoAlg<double, 8, {1, 1, 1, 1, 1, 1, 1, 1}>>("8d", 64);
+    bench_algebra<GeoAlg<double, 10, {1, 1, 1, 1, 1, 1, 1, 1, 1, -1}>>("10d", 8);
+}
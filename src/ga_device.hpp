@@ -0,0 +1,257 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+
+#include <luisa/luisa-compute.h>
+#include "float6.hpp"
+#include "ga_graded.hpp"
+#include "vga6.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* 设备端(LuisaCompute DSL)的几何代数
+ * 系数按GradedGeoAlg的布局存成float数组, 乘法的符号和要算哪些项都在生成kernel时(host上)确定,
+ * 生成的DSL代码是完全展开的乘加, 没有循环和查表. 这样旋量可以在kernel里逐像素计算,
+ * 比如每个像素用不同的t做插值(运动模糊), 或者一次dispatch渲染多个切片
+ */
+
+// 6维旋量(偶子代数), 系数顺序同vga6::rotor_type::kBlades
+struct rotor6 {
+    std::array<float, 32> data;
+};
+LUISA_STRUCT(rotor6, data) {};
+using Rotor6 = Var<rotor6>;
+
+/* 旋量路径 exp(t B) R_0, 在host上分解好(见ga_device::make_rotor_path), kernel里对任意t求值
+ * B分解成3个互相正交的平面(转角angles, 等角的平面重复), exp(t B) R_0 = sum_S (prod_{i∈S} sin(t θ_i) prod_{i∉S} cos(t θ_i)) F_S,
+ * S取遍{0, 1, 2}的8个子集, F_S(偶数阶, 32个系数)放在terms[S * 32, S * 32 + 32)
+ */
+struct rotor_path6 {
+    std::array<float, 3> angles;
+    std::array<float, 8 * 32> terms;
+};
+LUISA_STRUCT(rotor_path6, angles, terms) {};
+using RotorPath6 = Var<rotor_path6>;
+
+namespace ga_device {
+/* 只存部分阶数的多重向量, 每个系数是一个DSL变量. 布局和乘法规则同GradedGeoAlg<GA, GradeMask>,
+ * 不同的是乘法在生成kernel时展开: 符号为0或者对应的基不存在的项根本不会出现在生成的代码里
+ */
+template <typename GA, size_t GradeMask>
+class DeviceGeoAlg {
+public:
+    using layout_type = GradedGeoAlg<GA, GradeMask>;
+    using this_type = DeviceGeoAlg<GA, GradeMask>;
+    static constexpr size_t kGradeMask = GradeMask;
+    static constexpr size_t kSize = layout_type::kSize;
+
+    std::array<Float, kSize> data;
+
+    DeviceGeoAlg() {
+        for (Float& coeff : data) { coeff = 0.F; }
+    }
+
+    // host上的常量
+    explicit DeviceGeoAlg(const layout_type& host) {
+        for (size_t slot = 0; slot < kSize; ++slot) { data[slot] = static_cast<float>(host.data[slot]); }
+    }
+
+    this_type operator+(const this_type& other) const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = data[slot] + other.data[slot]; }
+        return result;
+    }
+
+    [[nodiscard]] this_type operator*(const Float& scalar) const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = data[slot] * scalar; }
+        return result;
+    }
+
+    // 反转, 符号(-1)^{k(k-1)/2}, 在生成代码时就确定了
+    [[nodiscard]] this_type reverse() const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) {
+            const auto grade = std::popcount(layout_type::kBlades[slot]);
+            if (grade % 4 == 0 || grade % 4 == 1) {
+                result.data[slot] = data[slot];
+            } else {
+                result.data[slot] = -data[slot];
+            }
+        }
+        return result;
+    }
+
+    // 几何积, 只计算OutMask中的阶数
+    template <size_t OutMask, size_t OtherMask>
+    [[nodiscard]] DeviceGeoAlg<GA, OutMask> multiply(const DeviceGeoAlg<GA, OtherMask>& other) const {
+        using result_type = DeviceGeoAlg<GA, OutMask>;
+        using rhs_layout = typename DeviceGeoAlg<GA, OtherMask>::layout_type;
+        result_type result;
+        for (size_t slot_r = 0; slot_r < result_type::kSize; ++slot_r) {
+            const size_t idx_r = result_type::layout_type::kBlades[slot_r];
+            Float sum = 0.F;
+            for (size_t slot_a = 0; slot_a < kSize; ++slot_a) {
+                const size_t idx_a = layout_type::kBlades[slot_a];
+                const size_t slot_b = rhs_layout::kSlots[idx_a ^ idx_r];
+                if (slot_b == rhs_layout::kSize) { continue; }
+                const auto sign = GA::blade_sign(idx_a, idx_a ^ idx_r);
+                if (sign == 1) {
+                    sum += data[slot_a] * other.data[slot_b];
+                } else if (sign == -1) {
+                    sum -= data[slot_a] * other.data[slot_b];
+                } else if (sign != 0) {
+                    sum += static_cast<float>(sign) * data[slot_a] * other.data[slot_b];
+                }
+            }
+            result.data[slot_r] = sum;
+        }
+        return result;
+    }
+
+    // 几何积, 结果是可能出现的最窄的阶数集合
+    template <size_t OtherMask>
+    [[nodiscard]] auto operator*(const DeviceGeoAlg<GA, OtherMask>& other) const {
+        constexpr size_t kOutMask = ga_graded::product_grades<GA::kVectorsCnt>(GradeMask, OtherMask);
+        return multiply<kOutMask>(other);
+    }
+
+    // 三明治积 this * val * ~this, 只保留val的阶数
+    template <size_t OtherMask>
+    [[nodiscard]] DeviceGeoAlg<GA, OtherMask> sandwich(const DeviceGeoAlg<GA, OtherMask>& val) const {
+        return (*this * val).template multiply<OtherMask>(reverse());
+    }
+};
+
+using rotor_type = DeviceGeoAlg<vga6::ga_type, vga6::rotor_type::kGradeMask>;
+using vector_type = DeviceGeoAlg<vga6::ga_type, vga6::vector_type::kGradeMask>;
+
+[[nodiscard]] inline rotor_type load(const Rotor6& rotor) {
+    rotor_type result;
+    for (size_t slot = 0; slot < rotor_type::kSize; ++slot) { result.data[slot] = rotor.data[slot]; }
+    return result;
+}
+
+[[nodiscard]] inline Rotor6 store(const rotor_type& rotor) {
+    ArrayFloat<rotor_type::kSize> data;
+    for (size_t slot = 0; slot < rotor_type::kSize; ++slot) { data[slot] = rotor.data[slot]; }
+    return def<rotor6>(data);
+}
+
+[[nodiscard]] inline vector_type load(const Float6& point) {
+    vector_type result;
+    result.data[0] = point.first.x;
+    result.data[1] = point.first.y;
+    result.data[2] = point.first.z;
+    result.data[3] = point.second.x;
+    result.data[4] = point.second.y;
+    result.data[5] = point.second.z;
+    return result;
+}
+
+[[nodiscard]] inline Float6 store(const vector_type& point) {
+    return def<float6>(
+        make_float3(point.data[0], point.data[1], point.data[2]),
+        make_float3(point.data[3], point.data[4], point.data[5])
+    );
+}
+
+// host上的旋量转成kernel参数
+[[nodiscard]] inline rotor6 to_rotor6(const vga6::rotor_type& rotor) {
+    rotor6 result{};
+    for (size_t slot = 0; slot < vga6::rotor_type::kSize; ++slot) { result.data[slot] = static_cast<float>(rotor.data[slot]); }
+    return result;
+}
+
+// R v ~R, 两次展开的分阶乘法: 32 * 6项得到奇数阶部分, 再32 * 6项只算1阶
+[[nodiscard]] inline Float6 sandwich(const Rotor6& rotor, const Float6& point) {
+    return store(load(rotor).sandwich(load(point)));
+}
+
+/* 从start到end的旋量路径, 同vga6::rotor_lerp: exp(t log(end ~start)) start
+ * 对数的不变量分解只和两端有关, 在host上做一次; 每组等角平面的指数是 sum_j cos^{m-j} sin^j W_j, W_j = <S^j>_{2j} / j!
+ * (S是这组的单位平面之和), 展开所有组的乘积后按sin/cos的单项式合并, 最后右乘start
+ */
+[[nodiscard]] inline rotor_path6 make_rotor_path(const vga6::ga_type& start, const vga6::ga_type& end) {
+    using vga6::bivector_type;
+    using vga6::quadvector_type;
+    using vga6::pseudoscalar_type;
+
+    const vga6::ga_type relative_rotor = ga_expr::lazy(end) * ga_expr::lazy(start).reverse() * (1. / start.norm_squared());
+    const vga6::BivectorSplit split = vga6::split_bivector(vga6::rotor_log(vga6::rotor_type{relative_rotor}));
+
+    vga6::rotor_type identity;
+    identity.data[0] = 1.;
+    // terms[S]: 子集S对应的系数, 一开始只有空集 = 1
+    std::array<vga6::rotor_type, 8> terms{};
+    terms[0] = identity;
+    rotor_path6 result{};
+    size_t first_slot = 0;
+    for (size_t group = 0; group < split.count; ++group) {
+        // 欧氏度量下二重向量的平方都是负的
+        const double angle = std::sqrt(std::abs(split.squares[group]));
+        const size_t multiplicity = split.multiplicity[group];
+        const bivector_type plane = split.parts[group] * (1. / angle);
+        const quadvector_type wedge_2 = plane.multiply<0b0010000>(plane) * 0.5;
+        const pseudoscalar_type wedge_3 = wedge_2.multiply<0b1000000>(plane) * (1. / 3.);
+        const std::array<vga6::rotor_type, 4> powers{
+            identity, vga6::rotor_type{plane}, vga6::rotor_type{wedge_2}, vga6::rotor_type{wedge_3}
+        };
+
+        // 这一组占first_slot开始的multiplicity个平面, W_j对应其中前j个
+        std::array<vga6::rotor_type, 8> next{};
+        for (size_t subset = 0; subset < 8; ++subset) {
+            if (terms[subset].data == vga6::rotor_type{}.data) { continue; }
+            for (size_t power = 0; power <= multiplicity; ++power) {
+                const size_t slots = ((size_t(1) << power) - 1) << first_slot;
+                next[subset | slots] = next[subset | slots] + vga6::rotor_type{
+                    terms[subset].multiply<vga6::rotor_type::kGradeMask>(powers[power])
+                };
+            }
+        }
+        terms = next;
+        for (size_t slot = first_slot; slot < first_slot + multiplicity; ++slot) { result.angles[slot] = static_cast<float>(angle); }
+        first_slot += multiplicity;
+    }
+
+    const vga6::rotor_type start_rotor{start};
+    for (size_t subset = 0; subset < 8; ++subset) {
+        const vga6::rotor_type term = terms[subset].multiply<vga6::rotor_type::kGradeMask>(start_rotor);
+        for (size_t slot = 0; slot < vga6::rotor_type::kSize; ++slot) {
+            result.terms[subset * vga6::rotor_type::kSize + slot] = static_cast<float>(term.data[slot]);
+        }
+    }
+    return result;
+}
+
+// 路径上t处的旋量: 3对sin/cos, 8个单项式, 再8 * 32次乘加
+[[nodiscard]] inline Rotor6 rotor_path_at(const RotorPath6& path, const Float& t_val) {
+    std::array<Float, 3> cos_part;
+    std::array<Float, 3> sin_part;
+    for (size_t slot = 0; slot < 3; ++slot) {
+        cos_part[slot] = cos(t_val * path.angles[slot]);
+        sin_part[slot] = sin(t_val * path.angles[slot]);
+    }
+
+    rotor_type result;
+    for (size_t subset = 0; subset < 8; ++subset) {
+        Float weight = 1.F;
+        for (size_t slot = 0; slot < 3; ++slot) {
+            weight *= (subset >> slot) & 1 ? sin_part[slot] : cos_part[slot];
+        }
+        for (size_t slot = 0; slot < rotor_type::kSize; ++slot) {
+            result.data[slot] += weight * path.terms[subset * rotor_type::kSize + slot];
+        }
+    }
+    return store(result);
+}
+}  // namespace ga_device
+
+// 旋量的乘积, 32 * 32项全部展开
+[[nodiscard]] inline Rotor6 operator*(const Rotor6& lhs, const Rotor6& rhs) {
+    return ga_device::store(ga_device::load(lhs).multiply<vga6::rotor_type::kGradeMask>(ga_device::load(rhs)));
+}
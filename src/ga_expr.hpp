@@ -0,0 +1,276 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "ga.hpp"
+
+/* GeoAlg的惰性表达式
+ * lazy(R) * v * lazy(R).reverse() * 0.5 这样的式子不会立刻计算: 缩放, 反转, 分级对合, 取阶数都只记在节点上,
+ * 赋值给GeoAlg(或调用eval)时才并进相邻的乘法(GeoAlg::fused_product)一起算, 中间不产生完整的临时多重向量.
+ * 只有乘积本身作为另一个乘法的输入时才需要在栈上算出来. 算出来的值带着非零基的掩码, 外层的乘法照样按阶数选展开的版本:
+ * 三明治积<R v ~R>_1里R v只算奇数阶, 外层是奇数阶 * 偶数阶且只算6个1阶的基, 两次各6 * 32项;
+ * 直接写R * v * ~R时第二个乘法要算全部32个奇数阶的基, 是32 * 32项
+ *
+ * 叶子节点只保存指针, 表达式不能比它引用的多重向量活得更久, 只应该在一个完整的表达式里使用
+ */
+namespace ga_expr {
+template <typename GA, typename GA::BladeMap Map = GA::BladeMap::kIdentity>
+class View;
+
+template <typename GA, typename GA::ProductKind Kind, typename Lhs, typename Rhs>
+class Product;
+
+namespace detail {
+template <typename T>
+struct is_expr : std::false_type {};
+
+template <typename GA, typename GA::BladeMap Map>
+struct is_expr<View<GA, Map>> : std::true_type {};
+
+template <typename GA, typename GA::ProductKind Kind, typename Lhs, typename Rhs>
+struct is_expr<Product<GA, Kind, Lhs, Rhs>> : std::true_type {};
+
+// 乘法的一个输入: 指向的多重向量和额外的缩放
+template <typename GA>
+struct Operand {
+    const GA* value;
+    typename GA::value_type scale;
+};
+
+/* 运行时的阶数掩码转成GeoAlg::fused_product的模板参数. grade()只能取出单个阶数, 所以只有这几种情况(或者取空, 结果为0)
+ * 每种情况直接返回乘法的结果, 不先构造再赋值
+ */
+template <
+    typename GA, typename GA::ProductKind Kind, typename GA::BladeMap MapA, typename GA::BladeMap MapB, size_t Grade = 0
+>
+GA fused_product(const GA& lhs, const GA& rhs, typename GA::value_type scale, size_t grades) {
+    if constexpr (Grade == 0) {
+        if (grades == GA::kAllGrades) { return GA::template fused_product<Kind, MapA, MapB>(lhs, rhs, scale); }
+    }
+    if constexpr (Grade > GA::kVectorsCnt) {
+        return GA();
+    } else {
+        if (grades == size_t(1) << Grade) {
+            return GA::template fused_product<Kind, MapA, MapB, size_t(1) << Grade>(lhs, rhs, scale);
+        }
+        return fused_product<GA, Kind, MapA, MapB, Grade + 1>(lhs, rhs, scale, grades);
+    }
+}
+}  // namespace detail
+
+template <typename T>
+concept expression = detail::is_expr<std::remove_cvref_t<T>>::value;
+
+// GeoAlg本身
+template <typename T>
+concept multivector = !expression<T> && requires {
+    typename T::BladeMap;
+    typename T::ProductKind;
+    T::kBasesCnt;
+};
+
+// 一个多重向量上的逐基变换: map(<val>_{grades}) * scale
+template <typename GA, typename GA::BladeMap Map>
+class View {
+public:
+    using full_type = GA;
+    using value_type = typename GA::value_type;
+    using this_type = View<GA, Map>;
+    static constexpr typename GA::BladeMap kMap = Map;
+
+    explicit View(const GA& val, value_type scale = value_type(1), size_t grades = GA::kAllGrades)
+        : val_(&val), scale_(scale), grades_(grades) {}
+
+    [[nodiscard]] View<GA, GA::compose(Map, GA::BladeMap::kReverse)> reverse() const {
+        return View<GA, GA::compose(Map, GA::BladeMap::kReverse)>(*val_, scale_, grades_);
+    }
+
+    [[nodiscard]] View<GA, GA::compose(Map, GA::BladeMap::kInvolution)> grade_involution() const {
+        return View<GA, GA::compose(Map, GA::BladeMap::kInvolution)>(*val_, scale_, grades_);
+    }
+
+    [[nodiscard]] View<GA, GA::compose(Map, GA::BladeMap::kConjugate)> conjugate() const {
+        return View<GA, GA::compose(Map, GA::BladeMap::kConjugate)>(*val_, scale_, grades_);
+    }
+
+    // <A>_k
+    [[nodiscard]] this_type grade(size_t grade) const {
+        return this_type(*val_, scale_, grades_ & (size_t(1) << grade));
+    }
+
+    [[nodiscard]] this_type operator*(value_type scalar) const {
+        return this_type(*val_, scale_ * scalar, grades_);
+    }
+
+    [[nodiscard]] friend this_type operator*(value_type scalar, const this_type& val) {
+        return val * scalar;
+    }
+
+    [[nodiscard]] this_type operator-() const {
+        return this_type(*val_, -scale_, grades_);
+    }
+
+    // 算出结果, 一次遍历
+    [[nodiscard]] GA eval() const {
+        GA result;
+        for (size_t i = 0; i < GA::kBasesCnt; ++i) {
+            if ((grades_ >> std::popcount(i)) & 1) {
+                result.data[i] = GA::map_sign(Map, i) * scale_ * val_->data[i];
+            }
+        }
+        return result;
+    }
+
+    operator GA() const {  // NOLINT(google-explicit-constructor) 赋值时求值
+        return eval();
+    }
+
+    /* 作为乘法的输入: 把输入交给func, 返回func的结果. 逐基变换交给乘法(kMap), 缩放合并到乘法的scale里;
+     * 只有取了阶数时才要在栈上投影一次. grade()只能取出单个阶数(或者什么都不剩),
+     * grade_projection只写这一阶的基, 投影的掩码也就只有这一阶
+     */
+    template <typename Func>
+    [[nodiscard]] auto bind(Func&& func) const {
+        if (grades_ == GA::kAllGrades) { return func(detail::Operand<GA>{val_, scale_}); }
+        const GA projected = grades_ == 0 ? GA() : val_->grade_projection(std::countr_zero(grades_));
+        return func(detail::Operand<GA>{&projected, scale_});
+    }
+
+private:
+    const GA* val_;
+    value_type scale_;
+    size_t grades_;
+};
+
+// 两个表达式的乘积: <lhs * rhs>_{grades} * scale
+template <typename GA, typename GA::ProductKind Kind, typename Lhs, typename Rhs>
+class Product {
+public:
+    using full_type = GA;
+    using value_type = typename GA::value_type;
+    using this_type = Product<GA, Kind, Lhs, Rhs>;
+    static constexpr typename GA::BladeMap kMap = GA::BladeMap::kIdentity;  // 乘积作为输入时已经算好了
+
+    Product(const Lhs& lhs, const Rhs& rhs, value_type scale = value_type(1), size_t grades = GA::kAllGrades)
+        : lhs_(lhs), rhs_(rhs), scale_(scale), grades_(grades) {}
+
+    // ~(AB) = ~B ~A, 内积和外积也一样. 反转不改变阶数, 所以grades不用变
+    [[nodiscard]] auto reverse() const {
+        using result_type = Product<GA, Kind, decltype(rhs_.reverse()), decltype(lhs_.reverse())>;
+        return result_type(rhs_.reverse(), lhs_.reverse(), scale_, grades_);
+    }
+
+    // 分级对合是自同构: (AB)^ = A^ B^
+    [[nodiscard]] auto grade_involution() const {
+        using result_type = Product<GA, Kind, decltype(lhs_.grade_involution()), decltype(rhs_.grade_involution())>;
+        return result_type(lhs_.grade_involution(), rhs_.grade_involution(), scale_, grades_);
+    }
+
+    [[nodiscard]] auto conjugate() const {
+        return reverse().grade_involution();
+    }
+
+    // <AB>_k, 展开的乘法只计算k阶的系数. 取不同的阶数结果为0
+    [[nodiscard]] this_type grade(size_t grade) const {
+        return this_type(lhs_, rhs_, scale_, grades_ & (size_t(1) << grade));
+    }
+
+    [[nodiscard]] this_type operator*(value_type scalar) const {
+        return this_type(lhs_, rhs_, scale_ * scalar, grades_);
+    }
+
+    [[nodiscard]] friend this_type operator*(value_type scalar, const this_type& val) {
+        return val * scalar;
+    }
+
+    [[nodiscard]] this_type operator-() const {
+        return this_type(lhs_, rhs_, -scale_, grades_);
+    }
+
+    // 两边的输入都只在栈上构造一次(乘积或者投影), 结果直接返回, 不经过先清零再赋值的临时值
+    [[nodiscard]] GA eval() const {
+        return lhs_.bind([&](const detail::Operand<GA>& lhs) {
+            return rhs_.bind([&](const detail::Operand<GA>& rhs) {
+                return detail::fused_product<GA, Kind, Lhs::kMap, Rhs::kMap>(
+                    *lhs.value, *rhs.value, scale_ * lhs.scale * rhs.scale, grades_
+                );
+            });
+        });
+    }
+
+    operator GA() const {  // NOLINT(google-explicit-constructor) 赋值时求值
+        return eval();
+    }
+
+    // 作为另一个乘法的输入时先在栈上算出来
+    template <typename Func>
+    [[nodiscard]] auto bind(Func&& func) const {
+        const GA value = eval();
+        return func(detail::Operand<GA>{&value, value_type(1)});
+    }
+
+private:
+    Lhs lhs_;
+    Rhs rhs_;
+    value_type scale_;
+    size_t grades_;
+};
+
+// 表达式的入口
+template <typename GA>
+[[nodiscard]] View<GA> lazy(const GA& val) {
+    return View<GA>(val);
+}
+
+namespace detail {
+// GeoAlg转成恒等变换的View, 表达式原样返回
+template <typename T>
+decltype(auto) as_expr(const T& val) {
+    if constexpr (expression<T>) {
+        return val;
+    } else {
+        return View<T>(val);
+    }
+}
+
+template <typename T>
+using as_expr_t = std::remove_cvref_t<decltype(as_expr(std::declval<const T&>()))>;
+
+template <typename GA, typename GA::ProductKind Kind, typename Lhs, typename Rhs>
+auto make_product(const Lhs& lhs, const Rhs& rhs) {
+    return Product<GA, Kind, as_expr_t<Lhs>, as_expr_t<Rhs>>(as_expr(lhs), as_expr(rhs));
+}
+
+// 两边都是表达式, 或者一边是表达式另一边是同一个代数的GeoAlg
+template <typename Lhs, typename Rhs>
+concept operands = ((expression<Lhs> && (expression<Rhs> || multivector<Rhs>)) || (multivector<Lhs> && expression<Rhs>))
+    && std::is_same_v<typename as_expr_t<Lhs>::full_type, typename as_expr_t<Rhs>::full_type>;
+}  // namespace detail
+
+// 几何积
+template <typename Lhs, typename Rhs>
+    requires detail::operands<Lhs, Rhs>
+[[nodiscard]] auto operator*(const Lhs& lhs, const Rhs& rhs) {
+    using GA = typename detail::as_expr_t<Lhs>::full_type;
+    return detail::make_product<GA, GA::ProductKind::kGeometric>(lhs, rhs);
+}
+
+// 内积
+template <typename Lhs, typename Rhs>
+    requires detail::operands<Lhs, Rhs>
+[[nodiscard]] auto dot(const Lhs& lhs, const Rhs& rhs) {
+    using GA = typename detail::as_expr_t<Lhs>::full_type;
+    return detail::make_product<GA, GA::ProductKind::kInner>(lhs, rhs);
+}
+
+// 外积
+template <typename Lhs, typename Rhs>
+    requires detail::operands<Lhs, Rhs>
+[[nodiscard]] auto wedge(const Lhs& lhs, const Rhs& rhs) {
+    using GA = typename detail::as_expr_t<Lhs>::full_type;
+    return detail::make_product<GA, GA::ProductKind::kOuter>(lhs, rhs);
+}
+}  // namespace ga_expr
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <utility>
+
+#include "ga.hpp"
+
+namespace ga_graded {
+// 阶数集合用位掩码表示: 第k位为1表示包含k阶部分
+template <size_t NBase>
+constexpr size_t all_grades() {
+    return (size_t(1) << (NBase + 1)) - 1;
+}
+
+// 偶数阶: 0, 2, 4, ...
+template <size_t NBase>
+constexpr size_t even_grades() {
+    size_t mask = 0;
+    for (size_t grade = 0; grade <= NBase; grade += 2) { mask |= size_t(1) << grade; }
+    return mask;
+}
+
+// a阶和b阶的几何积中可能出现的阶数: |a-b|, |a-b|+2, ..., min(a+b, 2n-a-b)
+template <size_t NBase>
+constexpr size_t product_grades(size_t mask_a, size_t mask_b) {
+    size_t result = 0;
+    for (size_t grade_a = 0; grade_a <= NBase; ++grade_a) {
+        if (!(mask_a & (size_t(1) << grade_a))) { continue; }
+        for (size_t grade_b = 0; grade_b <= NBase; ++grade_b) {
+            if (!(mask_b & (size_t(1) << grade_b))) { continue; }
+            const size_t low = grade_a > grade_b ? grade_a - grade_b : grade_b - grade_a;
+            const size_t high = std::min(grade_a + grade_b, 2 * NBase - grade_a - grade_b);
+            for (size_t grade = low; grade <= high; grade += 2) { result |= size_t(1) << grade; }
+        }
+    }
+    return result;
+}
+}  // namespace ga_graded
+
+/* 只存储部分阶数的多重向量. GA是完整的GeoAlg类型, GradeMask是包含的阶数(见ga_graded::product_grades)
+ * data只存这些阶数的基的系数, 乘法也只遍历这些基, 结果的阶数在编译期推出来
+ */
+template <typename GA, size_t GradeMask>
+class GradedGeoAlg {
+public:
+    using full_type = GA;
+    using value_type = typename GA::value_type;
+    using this_type = GradedGeoAlg<GA, GradeMask>;
+    static constexpr size_t kGradeMask = GradeMask;
+
+    // 包含的基的个数
+    static constexpr size_t kSize = [] {
+        size_t size = 0;
+        for (size_t idx = 0; idx < GA::kBasesCnt; ++idx) {
+            if (GradeMask & (size_t(1) << std::popcount(idx))) { ++size; }
+        }
+        return size;
+    }();
+
+    // kBlades[i]是data[i]对应的基(GeoAlg::data的索引)
+    static constexpr std::array<size_t, kSize> kBlades = [] {
+        std::array<size_t, kSize> blades{};
+        size_t slot = 0;
+        for (size_t idx = 0; idx < GA::kBasesCnt; ++idx) {
+            if (GradeMask & (size_t(1) << std::popcount(idx))) { blades[slot++] = idx; }
+        }
+        return blades;
+    }();
+
+    // kSlots[基]是它在data中的位置, 不包含的基为kSize
+    static constexpr std::array<size_t, GA::kBasesCnt> kSlots = [] {
+        std::array<size_t, GA::kBasesCnt> slots{};
+        slots.fill(kSize);
+        for (size_t slot = 0; slot < kSize; ++slot) { slots[kBlades[slot]] = slot; }
+        return slots;
+    }();
+
+    // <e e>_0: data[i]对应的基自己的平方, 标量积只有这些项
+    static constexpr std::array<value_type, kSize> kSquareSigns = [] {
+        std::array<value_type, kSize> signs{};
+        for (size_t slot = 0; slot < kSize; ++slot) { signs[slot] = GA::blade_sign(kBlades[slot], kBlades[slot]); }
+        return signs;
+    }();
+
+    std::array<value_type, kSize> data{};
+
+    GradedGeoAlg()=default;
+
+    // 从完整的多重向量投影, 不包含的阶数直接丢掉
+    explicit GradedGeoAlg(const GA& full) {
+        for (size_t slot = 0; slot < kSize; ++slot) { data[slot] = full.data[kBlades[slot]]; }
+    }
+
+    // 从其他阶数集合转换, 只保留两边都有的基
+    template <size_t OtherMask>
+    explicit GradedGeoAlg(const GradedGeoAlg<GA, OtherMask>& other) {
+        for (size_t slot = 0; slot < kSize; ++slot) { data[slot] = other.coeff(kBlades[slot]); }
+    }
+
+    // 转成完整的多重向量
+    [[nodiscard]] GA to_full() const {
+        GA result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[kBlades[slot]] = data[slot]; }
+        return result;
+    }
+
+    // 基idx的系数, 不包含的基返回0
+    [[nodiscard]] value_type coeff(size_t idx) const {
+        return kSlots[idx] == kSize ? value_type(0) : data[kSlots[idx]];
+    }
+
+    this_type operator+(const this_type& other) const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = data[slot] + other.data[slot]; }
+        return result;
+    }
+
+    this_type operator-() const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = -data[slot]; }
+        return result;
+    }
+
+    this_type operator-(const this_type& other) const {
+        return *this + (-other);
+    }
+
+    [[nodiscard]] this_type operator*(value_type scalar) const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) { result.data[slot] = data[slot] * scalar; }
+        return result;
+    }
+
+    [[nodiscard]] friend this_type operator*(value_type scalar, const this_type& val) {
+        return val * scalar;
+    }
+
+    // 反转, 符号(-1)^{k(k-1)/2}
+    [[nodiscard]] this_type reverse() const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) {
+            const auto grade = std::popcount(kBlades[slot]);
+            result.data[slot] = (grade % 4 == 0 || grade % 4 == 1) ? data[slot] : -data[slot];
+        }
+        return result;
+    }
+
+    // 分级对合, 符号(-1)^k
+    [[nodiscard]] this_type grade_involution() const {
+        this_type result;
+        for (size_t slot = 0; slot < kSize; ++slot) {
+            result.data[slot] = std::popcount(kBlades[slot]) % 2 == 0 ? data[slot] : -data[slot];
+        }
+        return result;
+    }
+
+private:
+    template <typename, size_t>
+    friend class GradedGeoAlg;
+
+    // 结果基IdxR中来自左边第SlotA个基的那一项. 右边不包含对应的基或符号为0时这一项消失
+    template <typename Rhs, size_t IdxR, size_t SlotA>
+    static constexpr value_type product_term(const this_type& lhs, const Rhs& rhs) {
+        constexpr size_t kIdxA = kBlades[SlotA];
+        constexpr size_t kIdxB = kIdxA ^ IdxR;
+        constexpr size_t kSlotB = Rhs::kSlots[kIdxB];
+        if constexpr (kSlotB == Rhs::kSize) {
+            return value_type(0);
+        } else {
+            constexpr value_type kSign = GA::blade_sign(kIdxA, kIdxB);
+            if constexpr (kSign == value_type(0)) {
+                return value_type(0);
+            } else if constexpr (kSign == value_type(1)) {
+                return lhs.data[SlotA] * rhs.data[kSlotB];
+            } else if constexpr (kSign == value_type(-1)) {
+                return -(lhs.data[SlotA] * rhs.data[kSlotB]);
+            } else {
+                return kSign * lhs.data[SlotA] * rhs.data[kSlotB];
+            }
+        }
+    }
+
+    template <typename Rhs, size_t IdxR, size_t... SlotA>
+    static constexpr value_type product_blade(
+        const this_type& lhs, const Rhs& rhs, std::index_sequence<SlotA...> /*unused*/
+    ) {
+        return (value_type(0) + ... + product_term<Rhs, IdxR, SlotA>(lhs, rhs));
+    }
+
+    template <typename Result, typename Rhs, size_t... SlotR>
+    static constexpr Result product_unrolled(
+        const this_type& lhs, const Rhs& rhs, std::index_sequence<SlotR...> /*unused*/
+    ) {
+        Result result;
+        ((result.data[SlotR] = product_blade<Rhs, Result::kBlades[SlotR]>(
+            lhs, rhs, std::make_index_sequence<kSize>{}
+        )), ...);
+        return result;
+    }
+
+public:
+    // 几何积, 只计算OutMask中的阶数. 已知结果只有某些阶时(比如R v ~R只有1阶)可以少算很多项
+    template <size_t OutMask, size_t OtherMask>
+    [[nodiscard]] GradedGeoAlg<GA, OutMask> multiply(const GradedGeoAlg<GA, OtherMask>& other) const {
+        using result_type = GradedGeoAlg<GA, OutMask>;
+        return product_unrolled<result_type>(*this, other, std::make_index_sequence<result_type::kSize>{});
+    }
+
+    // 几何积, 结果是可能出现的最窄的阶数集合
+    template <size_t OtherMask>
+    [[nodiscard]] auto operator*(const GradedGeoAlg<GA, OtherMask>& other) const {
+        constexpr size_t kOutMask = ga_graded::product_grades<GA::kVectorsCnt>(GradeMask, OtherMask);
+        return multiply<kOutMask>(other);
+    }
+
+    // 标量积 <A B>_0: 只有同一个基的两项乘起来才落在标量上, kSize项的点积
+    [[nodiscard]] value_type scalar_product(const this_type& other) const {
+        value_type result = 0;
+        for (size_t slot = 0; slot < kSize; ++slot) {
+            result += kSquareSigns[slot] * data[slot] * other.data[slot];
+        }
+        return result;
+    }
+
+    // 模长的平方: <A ~A>_0
+    [[nodiscard]] value_type norm_squared() const {
+        return reverse().scalar_product(*this);
+    }
+
+    [[nodiscard]] value_type norm() const {
+        return std::sqrt(std::abs(norm_squared()));
+    }
+
+    // 三明治积 this * val * ~this, 只保留val的阶数. this是versor时结果的阶数和val相同
+    template <size_t OtherMask>
+    [[nodiscard]] GradedGeoAlg<GA, OtherMask> sandwich(const GradedGeoAlg<GA, OtherMask>& val) const {
+        return (*this * val).template multiply<OtherMask>(reverse());
+    }
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+/* GeoAlg几何积的SIMD实现
+ *
+ * 结果的第k个系数是 sum_a sign(a, a^k) * lhs[a] * rhs[a^k].
+ * 对固定的a, sign(a, a^k)关于k是一个Walsh特征: sign(a, a^k) = s_a * (-1)^{popcount(k & w_a)},
+ * 所以把k按寄存器分成(寄存器q, 通道l)后:
+ *   - rhs[a^k]就是把rhs的第(q ^ (a / 通道数))个寄存器按通道异或(a % 通道数)重排
+ *   - 符号的通道部分是固定的几种±0.0掩码, 寄存器部分是编译期常量, 直接选fmadd或fnmadd
+ * 整个乘法只剩广播, 重排, 异或和FMA, 没有查表也没有分支
+ */
+namespace ga_simd {
+template <typename T>
+struct Traits {
+    static constexpr size_t kLanes = 0; // 0表示当前目标不支持
+};
+
+#if defined(__AVX512F__)
+template <>
+struct Traits<double> {
+    using reg = __m512d;
+    static constexpr size_t kLanes = 8;
+
+    static reg load(const double* ptr) { return _mm512_loadu_pd(ptr); }
+    static void store(double* ptr, reg val) { _mm512_storeu_pd(ptr, val); }
+    static reg zero() { return _mm512_setzero_pd(); }
+    static reg broadcast(double val) { return _mm512_set1_pd(val); }
+    static reg fmadd(reg lhs, reg rhs, reg acc) { return _mm512_fmadd_pd(lhs, rhs, acc); }
+    static reg fnmadd(reg lhs, reg rhs, reg acc) { return _mm512_fnmadd_pd(lhs, rhs, acc); }
+    static reg mul(reg lhs, reg rhs) { return _mm512_mul_pd(lhs, rhs); }
+    static reg add(reg lhs, reg rhs) { return _mm512_add_pd(lhs, rhs); }
+    // 不为0的通道的位掩码
+    static unsigned nonzero(reg val) { return _mm512_cmp_pd_mask(val, zero(), _CMP_NEQ_UQ); }
+    // 按位异或, mask是±0.0时就是逐通道变号
+    static reg flip(reg val, reg mask) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(val), _mm512_castpd_si512(mask)));
+    }
+
+    // 通道l换成通道l ^ M
+    template <size_t M>
+    static reg permute_xor(reg val) {
+        if constexpr (M == 0) {
+            return val;
+        } else {
+            return _mm512_permutexvar_pd(
+                _mm512_set_epi64(7 ^ M, 6 ^ M, 5 ^ M, 4 ^ M, 3 ^ M, 2 ^ M, 1 ^ M, 0 ^ M), val
+            );
+        }
+    }
+
+    // popcount(l & P)为奇数的通道取负
+    template <size_t P>
+    static reg flip_lanes(reg val) {
+        if constexpr (P == 0) {
+            return val;
+        } else {
+            #define LANE(l) (std::popcount(size_t(l) & P) % 2 ? -0.0 : 0.0)
+            const __m512d mask = _mm512_set_pd(LANE(7), LANE(6), LANE(5), LANE(4), LANE(3), LANE(2), LANE(1), LANE(0));
+            #undef LANE
+            return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(val), _mm512_castpd_si512(mask)));
+        }
+    }
+};
+
+template <>
+struct Traits<float> {
+    using reg = __m512;
+    static constexpr size_t kLanes = 16;
+
+    static reg load(const float* ptr) { return _mm512_loadu_ps(ptr); }
+    static void store(float* ptr, reg val) { _mm512_storeu_ps(ptr, val); }
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg broadcast(float val) { return _mm512_set1_ps(val); }
+    static reg fmadd(reg lhs, reg rhs, reg acc) { return _mm512_fmadd_ps(lhs, rhs, acc); }
+    static reg fnmadd(reg lhs, reg rhs, reg acc) { return _mm512_fnmadd_ps(lhs, rhs, acc); }
+    static reg mul(reg lhs, reg rhs) { return _mm512_mul_ps(lhs, rhs); }
+    static reg add(reg lhs, reg rhs) { return _mm512_add_ps(lhs, rhs); }
+    static unsigned nonzero(reg val) { return _mm512_cmp_ps_mask(val, zero(), _CMP_NEQ_UQ); }
+    static reg flip(reg val, reg mask) {
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(val), _mm512_castps_si512(mask)));
+    }
+
+    template <size_t M>
+    static reg permute_xor(reg val) {
+        if constexpr (M == 0) {
+            return val;
+        } else {
+            return _mm512_permutexvar_ps(_mm512_set_epi32(
+                15 ^ M, 14 ^ M, 13 ^ M, 12 ^ M, 11 ^ M, 10 ^ M, 9 ^ M, 8 ^ M,
+                7 ^ M, 6 ^ M, 5 ^ M, 4 ^ M, 3 ^ M, 2 ^ M, 1 ^ M, 0 ^ M
+            ), val);
+        }
+    }
+
+    template <size_t P>
+    static reg flip_lanes(reg val) {
+        if constexpr (P == 0) {
+            return val;
+        } else {
+            #define LANE(l) (std::popcount(size_t(l) & P) % 2 ? -0.F : 0.F)
+            const __m512 mask = _mm512_set_ps(
+                LANE(15), LANE(14), LANE(13), LANE(12), LANE(11), LANE(10), LANE(9), LANE(8),
+                LANE(7), LANE(6), LANE(5), LANE(4), LANE(3), LANE(2), LANE(1), LANE(0)
+            );
+            #undef LANE
+            return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(val), _mm512_castps_si512(mask)));
+        }
+    }
+};
+#elif defined(__AVX2__) && defined(__FMA__)
+template <>
+struct Traits<double> {
+    using reg = __m256d;
+    static constexpr size_t kLanes = 4;
+
+    static reg load(const double* ptr) { return _mm256_loadu_pd(ptr); }
+    static void store(double* ptr, reg val) { _mm256_storeu_pd(ptr, val); }
+    static reg zero() { return _mm256_setzero_pd(); }
+    static reg broadcast(double val) { return _mm256_set1_pd(val); }
+    static reg fmadd(reg lhs, reg rhs, reg acc) { return _mm256_fmadd_pd(lhs, rhs, acc); }
+    static reg fnmadd(reg lhs, reg rhs, reg acc) { return _mm256_fnmadd_pd(lhs, rhs, acc); }
+    static reg mul(reg lhs, reg rhs) { return _mm256_mul_pd(lhs, rhs); }
+    static reg add(reg lhs, reg rhs) { return _mm256_add_pd(lhs, rhs); }
+    static unsigned nonzero(reg val) { return _mm256_movemask_pd(_mm256_cmp_pd(val, zero(), _CMP_NEQ_UQ)); }
+    static reg flip(reg val, reg mask) { return _mm256_xor_pd(val, mask); }
+
+    template <size_t M>
+    static reg permute_xor(reg val) {
+        if constexpr (M == 0) {
+            return val;
+        } else {
+            return _mm256_permute4x64_pd(val, (0 ^ M) | ((1 ^ M) << 2) | ((2 ^ M) << 4) | ((3 ^ M) << 6));
+        }
+    }
+
+    template <size_t P>
+    static reg flip_lanes(reg val) {
+        if constexpr (P == 0) {
+            return val;
+        } else {
+            #define LANE(l) (std::popcount(size_t(l) & P) % 2 ? -0.0 : 0.0)
+            return _mm256_xor_pd(val, _mm256_set_pd(LANE(3), LANE(2), LANE(1), LANE(0)));
+            #undef LANE
+        }
+    }
+};
+
+template <>
+struct Traits<float> {
+    using reg = __m256;
+    static constexpr size_t kLanes = 8;
+
+    static reg load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+    static void store(float* ptr, reg val) { _mm256_storeu_ps(ptr, val); }
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg broadcast(float val) { return _mm256_set1_ps(val); }
+    static reg fmadd(reg lhs, reg rhs, reg acc) { return _mm256_fmadd_ps(lhs, rhs, acc); }
+    static reg fnmadd(reg lhs, reg rhs, reg acc) { return _mm256_fnmadd_ps(lhs, rhs, acc); }
+    static reg mul(reg lhs, reg rhs) { return _mm256_mul_ps(lhs, rhs); }
+    static reg add(reg lhs, reg rhs) { return _mm256_add_ps(lhs, rhs); }
+    static unsigned nonzero(reg val) { return _mm256_movemask_ps(_mm256_cmp_ps(val, zero(), _CMP_NEQ_UQ)); }
+    static reg flip(reg val, reg mask) { return _mm256_xor_ps(val, mask); }
+
+    template <size_t M>
+    static reg permute_xor(reg val) {
+        if constexpr (M == 0) {
+            return val;
+        } else {
+            return _mm256_permutevar8x32_ps(
+                val, _mm256_set_epi32(7 ^ M, 6 ^ M, 5 ^ M, 4 ^ M, 3 ^ M, 2 ^ M, 1 ^ M, 0 ^ M)
+            );
+        }
+    }
+
+    template <size_t P>
+    static reg flip_lanes(reg val) {
+        if constexpr (P == 0) {
+            return val;
+        } else {
+            #define LANE(l) (std::popcount(size_t(l) & P) % 2 ? -0.F : 0.F)
+            return _mm256_xor_ps(val, _mm256_set_ps(
+                LANE(7), LANE(6), LANE(5), LANE(4), LANE(3), LANE(2), LANE(1), LANE(0)
+            ));
+            #undef LANE
+        }
+    }
+};
+#endif
+
+/* 左边基a对应的Walsh特征: sign(a, a^k) = kBase[a] * (-1)^{popcount(k & kMask[a])}
+ * 由GA::blade_sign在编译期推出; 度量退化(有基的平方为0)时不成立, 此时不走SIMD
+ */
+template <typename GA>
+struct SignCharacter {
+    using T = typename GA::value_type;
+    static constexpr size_t kBlades = GA::kBasesCnt;
+
+    struct Table {
+        std::array<T, kBlades> base{};
+        std::array<size_t, kBlades> mask{};
+        bool valid = true;
+    };
+
+    static constexpr Table kTable = [] {
+        Table table;
+        for (size_t idx_a = 0; idx_a < kBlades; ++idx_a) {
+            table.base[idx_a] = GA::blade_sign(idx_a, idx_a);
+            for (size_t bit = 0; bit < GA::kVectorsCnt; ++bit) {
+                if (GA::blade_sign(idx_a, idx_a ^ (size_t(1) << bit)) != table.base[idx_a]) {
+                    table.mask[idx_a] |= size_t(1) << bit;
+                }
+            }
+            for (size_t idx_k = 0; idx_k < kBlades; ++idx_k) {
+                const T expect = std::popcount(idx_k & table.mask[idx_a]) % 2 ? -table.base[idx_a] : table.base[idx_a];
+                if (table.base[idx_a] == T(0) || GA::blade_sign(idx_a, idx_a ^ idx_k) != expect) {
+                    table.valid = false;
+                }
+            }
+        }
+        return table;
+    }();
+};
+
+// 当前目标是否能对GA走SIMD乘法
+template <typename GA>
+constexpr bool has_product() {
+    using T = typename GA::value_type;
+    constexpr size_t kLanes = Traits<T>::kLanes;
+    if constexpr (kLanes == 0 || GA::kBasesCnt < kLanes || !GA::kUnrolled) {
+        return false;
+    } else {
+        return SignCharacter<GA>::kTable.valid;
+    }
+}
+
+// Count(不超过64)个系数中不为0的位掩码, 支持SIMD时每个寄存器只要一次比较
+template <typename T, size_t Count>
+std::uint64_t nonzero_mask(const T* data) {
+    static_assert(Count <= 64);
+    constexpr size_t kLanes = Traits<T>::kLanes;
+    std::uint64_t mask = 0;
+    if constexpr (kLanes != 0 && Count % kLanes == 0) {
+        for (size_t i = 0; i < Count; i += kLanes) {
+            mask |= std::uint64_t(Traits<T>::nonzero(Traits<T>::load(data + i))) << i;
+        }
+    } else {
+        for (size_t i = 0; i < Count; ++i) { mask |= std::uint64_t(data[i] != T(0)) << i; }
+    }
+    return mask;
+}
+
+namespace detail {
+template <typename T, size_t... Q>
+T weighted_dot(const T* weights, const T* lhs, const T* rhs, std::index_sequence<Q...> /*unused*/) {
+    using traits = Traits<T>;
+    using reg = typename traits::reg;
+    constexpr size_t kLanes = traits::kLanes;
+    reg acc[4] = {traits::zero(), traits::zero(), traits::zero(), traits::zero()};
+    ((acc[Q % 4] = traits::fmadd(
+        traits::mul(traits::load(weights + Q * kLanes), traits::load(lhs + Q * kLanes)), traits::load(rhs + Q * kLanes), acc[Q % 4]
+    )), ...);
+    alignas(64) T sums[kLanes];
+    traits::store(sums, traits::add(traits::add(acc[0], acc[1]), traits::add(acc[2], acc[3])));
+    T result = 0;
+    for (size_t lane = 0; lane < kLanes; ++lane) { result += sums[lane]; }
+    return result;
+}
+}  // namespace detail
+
+/* sum_i weights[i] * lhs[i] * rhs[i], Count个系数. 标量积/模长平方只有这些项(weights是每个基自己平方的符号)
+ * 支持SIMD时展开成每个寄存器一次乘法和一次FMA, 4路分开累加, 最后再横向求和
+ */
+template <typename T, size_t Count>
+T weighted_dot(const T* weights, const T* lhs, const T* rhs) {
+    constexpr size_t kLanes = Traits<T>::kLanes;
+    if constexpr (kLanes != 0 && Count % kLanes == 0) {
+        return detail::weighted_dot(weights, lhs, rhs, std::make_index_sequence<Count / kLanes>{});
+    } else {
+        std::array<T, 4> lanes{};
+        for (size_t i = 0; i < Count; ++i) { lanes[i % 4] += weights[i] * lhs[i] * rhs[i]; }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+}
+
+namespace detail {
+/* MapA, MapB是两边的逐基变换(GA::BladeMap): 左边的符号是每个基的编译期常量, 直接并进fmadd/fnmadd的选择;
+ * 右边的符号在载入寄存器时异或一次±0.0掩码
+ */
+template <typename GA, auto MapA, auto MapB>
+struct Product {
+    using T = typename GA::value_type;
+    using traits = Traits<T>;
+    using reg = typename traits::reg;
+    static constexpr size_t kLanes = traits::kLanes;
+    static constexpr size_t kRegs = GA::kBasesCnt / kLanes;
+    static constexpr auto kSigns = SignCharacter<GA>::kTable;
+
+    // 右边每个基的变换对应的±0.0
+    static constexpr auto kRhsFlip = [] {
+        std::array<T, GA::kBasesCnt> flip{};
+        for (size_t idx = 0; idx < GA::kBasesCnt; ++idx) { flip[idx] = GA::map_sign(MapB, idx) < T(0) ? T(-0.0) : T(0.0); }
+        return flip;
+    }();
+
+    // rhs按通道异或M重排后的所有寄存器. 用C数组是因为std::array<__m256d>会丢掉对齐属性
+    using permuted = reg[kLanes][kRegs];
+    using accumulator = reg[kRegs];
+
+    template <size_t Q>
+    static reg load_rhs(const T* rhs) {
+        if constexpr (MapB == decltype(MapB)::kIdentity) {
+            return traits::load(rhs + Q * kLanes);
+        } else {
+            return traits::flip(traits::load(rhs + Q * kLanes), traits::load(kRhsFlip.data() + Q * kLanes));
+        }
+    }
+
+    template <size_t M, size_t... Q>
+    static void permute(const permuted& loaded, permuted& out, std::index_sequence<Q...> /*unused*/) {
+        ((out[M][Q] = traits::template permute_xor<M>(loaded[0][Q])), ...);
+    }
+
+    template <size_t IdxA, size_t Q>
+    static void accumulate(reg coeff_a, const permuted& rhs, accumulator& acc) {
+        constexpr size_t kHigh = IdxA / kLanes;
+        constexpr size_t kLow = IdxA % kLanes;
+        constexpr size_t kMask = kSigns.mask[IdxA];
+        // 寄存器q的符号: s_a * map_a(a) * (-1)^{popcount(q & 特征的高位)}
+        constexpr bool kNegative = (kSigns.base[IdxA] * GA::map_sign(MapA, IdxA) < T(0))
+            != (std::popcount(Q & (kMask / kLanes)) % 2 == 1);
+        const reg term = traits::template flip_lanes<kMask % kLanes>(rhs[kLow][Q ^ kHigh]);
+        if constexpr (kNegative) {
+            acc[Q] = traits::fnmadd(coeff_a, term, acc[Q]);
+        } else {
+            acc[Q] = traits::fmadd(coeff_a, term, acc[Q]);
+        }
+    }
+
+    template <size_t IdxA, size_t... Q>
+    static void row(const T* lhs, const permuted& rhs, accumulator& acc, std::index_sequence<Q...> /*unused*/) {
+        const reg coeff_a = traits::broadcast(lhs[IdxA]);
+        (accumulate<IdxA, Q>(coeff_a, rhs, acc), ...);
+    }
+
+    template <bool Scaled, size_t... M, size_t... IdxA, size_t... Q>
+    static void run(
+        const T* lhs, const T* rhs, T* out, T scale,
+        std::index_sequence<M...> /*unused*/, std::index_sequence<IdxA...> /*unused*/, std::index_sequence<Q...> seq_q
+    ) {
+        permuted rhs_permuted;
+        ((rhs_permuted[0][Q] = load_rhs<Q>(rhs)), ...);
+        (permute<M>(rhs_permuted, rhs_permuted, seq_q), ...);
+        accumulator acc;
+        ((acc[Q] = traits::zero()), ...);
+        (row<IdxA>(lhs, rhs_permuted, acc, seq_q), ...);
+        if constexpr (Scaled) {
+            const reg factor = traits::broadcast(scale);
+            ((acc[Q] = traits::mul(acc[Q], factor)), ...);
+        }
+        (traits::store(out + Q * kLanes, acc[Q]), ...);
+    }
+};
+}  // namespace detail
+
+/* out = map_a(lhs) * map_b(rhs) (几何积), Scaled时再乘以scale
+ * 三个指针都指向GA::kBasesCnt个系数
+ */
+template <
+    typename GA,
+    auto MapA = GA::BladeMap::kIdentity,
+    auto MapB = GA::BladeMap::kIdentity,
+    bool Scaled = false
+>
+void geometric_product(
+    const typename GA::value_type* lhs, const typename GA::value_type* rhs, typename GA::value_type* out,
+    typename GA::value_type scale = 1
+) {
+    using product = detail::Product<GA, MapA, MapB>;
+    product::template run<Scaled>(
+        lhs, rhs, out, scale,
+        std::make_index_sequence<product::kLanes>{},
+        std::make_index_sequence<GA::kBasesCnt>{},
+        std::make_index_sequence<product::kRegs>{}
+    );
+}
+}  // namespace ga_simd
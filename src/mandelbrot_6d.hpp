@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <luisa/luisa-compute.h>
+#include "complex.hpp"
+#include "float6.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* 六维mandelbrot集的逐像素计算, 在kernel里调用(生成的是内联的DSL代码)
+ * 逐像素kernel和分块渲染(tiled_render.hpp)共用, 保证两者的结果逐位一致
+ */
+namespace mandelbrot_6d {
+// 像素中心的uv坐标
+[[nodiscard]] inline Float2 pixel_uv(const UInt2& pixel, const UInt2& size) {
+    return (make_float2(pixel) + 0.5f) / make_float2(size);
+}
+
+// 向量(u, v, 0, 0, 0, 0)旋转, 缩放(都在这一帧的矩阵里)然后移动
+[[nodiscard]] inline Float6 sample_position(const Float2& uv_pos, const Float6x6& transform, const Float6& translate_vec) {
+    return transform * def<float6>(
+        make_float3(uv_pos - make_float2(0.5, 0.5), 0.F),
+        make_float3(0)
+    ) + translate_vec;
+}
+
+/* z^X的算法, 整帧统一(分支对所有线程相同): X是整数时用平方求积, 是实数时用极坐标形式, 否则用log和exp
+ * 作为kernel参数传uint
+ */
+enum class PowMode : uint {
+    kComplex = 0,
+    kReal = 1,
+    kInteger = 2
+};
+
+constexpr float kMaxIntegerExponent = 64.F; // 更大的整数指数按实数处理, 免得平方求积的循环太长
+/* X在整帧上的变化, X的虚部和X到最近整数的距离小于它时按0处理.
+ * 相机路径的矩阵是浮点算出来的旋转, 本该为0的分量一般只是接近0
+ */
+constexpr float kExponentTolerance = 1e-6F;
+
+/* X = (pos.first.z, pos.second.x), uv只通过transform的前两列进入pos, uv的范围是[-0.5, 0.5],
+ * 所以两列的这两个分量都接近0时整帧的X就是translate_vec里的常数, 可以按它的值选算法
+ */
+[[nodiscard]] inline PowMode choose_pow_mode(const float6x6& transform, const float6& translate_vec) {
+    const float variation = 0.5F * std::max(
+        std::abs(transform.col1.first.z) + std::abs(transform.col2.first.z),
+        std::abs(transform.col1.second.x) + std::abs(transform.col2.second.x)
+    );
+    if (variation > kExponentTolerance || std::abs(translate_vec.second.x) > kExponentTolerance) { return PowMode::kComplex; }
+    const float exponent = translate_vec.first.z;
+    if (std::abs(exponent - std::round(exponent)) <= kExponentTolerance && std::abs(exponent) <= kMaxIntegerExponent) {
+        return PowMode::kInteger;
+    }
+    return PowMode::kReal;
+}
+
+// 迭代结束时的轨道状态, 写AOV(aov.hpp)用
+struct Orbit {
+    UInt iterations_cnt; // 和iterate的返回值相同
+    Complex z;           // 最后一次迭代的z
+    Complex derivative;  // dz/dc, 用来估计到集合边界的距离
+    Float trap_square;   // 轨道上|z|^2的最小值(orbit trap)
+};
+
+namespace detail {
+/* 迭代循环本身, pow_func(z)算z^X
+ * kTrackOrbit为false时不维护导数和orbit trap, 生成的代码和只数迭代次数的循环相同
+ */
+template <bool kTrackOrbit, typename PowFunc>
+[[nodiscard]] Orbit iterate_with(
+    const Float6& pos, const Complex& mb_x, const UInt& max_iterations, const Float& period_tolerance,
+    const PowFunc& pow_func
+) {
+    Complex mb_z{pos.first.x, pos.first.y};
+    Complex original_z = mb_z;
+    Complex mb_c{pos.second.y, pos.second.z};
+
+    UInt iterations_cnt = 0;
+    Complex saved_z = mb_z;
+    UInt save_at = 1u; // 下一次记下z的迭代次数
+    Float tolerance_square = period_tolerance * period_tolerance;
+    Complex derivative = def<complex>(0.F, 0.F);
+    Float trap_square = mb_z->abs_square();
+    for (auto iterate_idx: dynamic_range(max_iterations)) {
+        iterations_cnt += 1;
+        if_((mb_z - original_z)->abs_square() > 1000, break_);
+
+        if constexpr (kTrackOrbit) {
+            // 导数按对偶数传播, c的导数是1. z^X仍然用pow_func的算法, pow_with只补上导数
+            DualComplex dual_z = def<dual_complex>(mb_z, derivative)->pow_with(pow_func(mb_z), mb_x)
+                + def<dual_complex>(mb_c, def<complex>(1.F, 0.F));
+            mb_z = dual_z.value;
+            derivative = dual_z.derivative;
+            trap_square = min(trap_square, mb_z->abs_square());
+        } else {
+            mb_z = pow_func(mb_z) + mb_c;
+        }
+
+        if_((mb_z - saved_z)->abs_square() < tolerance_square, [&] {
+            iterations_cnt = max_iterations;
+            break_();
+        });
+        if_(iterations_cnt == save_at, [&] {
+            saved_z = mb_z;
+            save_at *= 2u;
+        });
+    };
+    return Orbit{iterations_cnt, mb_z, derivative, trap_square};
+}
+
+// 按pow_mode在循环外分支, 每种算法各生成一份循环
+template <bool kTrackOrbit>
+[[nodiscard]] Orbit iterate_orbit(
+    const Float6& pos, const UInt& max_iterations, const Float& period_tolerance, const UInt& pow_mode
+) {
+    Complex mb_x{pos.first.z, pos.second.x};
+    Orbit orbit;
+    if_(pow_mode == static_cast<uint>(PowMode::kInteger), [&] {
+        // X可能只是接近整数(见kExponentTolerance), 取最近的整数而不是截断
+        Int exponent = round(mb_x.real).cast<int>();
+        orbit = iterate_with<kTrackOrbit>(pos, mb_x, max_iterations, period_tolerance, [&](const Complex& mb_z) {
+            return mb_z->pow_integer(exponent);
+        });
+    }).elif_(pow_mode == static_cast<uint>(PowMode::kReal), [&] {
+        Float exponent = mb_x.real;
+        orbit = iterate_with<kTrackOrbit>(pos, mb_x, max_iterations, period_tolerance, [&](const Complex& mb_z) {
+            return mb_z->pow_real(exponent);
+        });
+    }).else_([&] {
+        // 一般的复数次幂: exp(X ln z)
+        orbit = iterate_with<kTrackOrbit>(pos, mb_x, max_iterations, period_tolerance, [&](const Complex& mb_z) {
+            return mb_z->pow(mb_x);
+        });
+    });
+    return orbit;
+}
+}  // namespace detail
+
+/*
+mandelbrot集扩展, 是六维结构
+迭代公式: Z_{n+1} = (Z_n)^X+C
+其中Z_n, X, C都是复数
+返回迭代次数, 等于max_iterations表示内部点
+pow_mode是PowMode, 按它在循环外分支, 每种算法各生成一份循环
+
+带Brent周期检测: 迭代次数到2的幂时记下当前的z, 之后的z回到它附近(距离小于period_tolerance)
+说明轨道已经落进周期不超过这个窗口的环, 不会再逃逸, 直接当作内部点结束. period_tolerance为0时不检测
+*/
+[[nodiscard]] inline UInt iterate(
+    const Float6& pos, const UInt& max_iterations, const Float& period_tolerance, const UInt& pow_mode
+) {
+    return detail::iterate_orbit<false>(pos, max_iterations, period_tolerance, pow_mode).iterations_cnt;
+}
+
+// 同iterate, 另外记下最后的z, dz/dc(按DualComplex传播)和orbit trap, 每次迭代多一次复数除法和两次乘法
+[[nodiscard]] inline Orbit iterate_orbit(
+    const Float6& pos, const UInt& max_iterations, const Float& period_tolerance, const UInt& pow_mode
+) {
+    return detail::iterate_orbit<true>(pos, max_iterations, period_tolerance, pow_mode);
+}
+
+/* 一个像素对应的c的变化量: uv每移动一个像素, c = (pos.second.y, pos.second.z)移动transform前两列里c的分量除以宽高.
+ * 取两个方向里较大的一个, 用来把c空间的距离换算成像素
+ */
+[[nodiscard]] inline float c_pixel_size(const float6x6& transform, uint width, uint height) {
+    const float along_u = std::hypot(transform.col1.second.y, transform.col1.second.z) / static_cast<float>(width);
+    const float along_v = std::hypot(transform.col2.second.y, transform.col2.second.z) / static_cast<float>(height);
+    return std::max(along_u, along_v);
+}
+
+/* 逃逸点到集合边界的距离估计(c空间): |z| ln|z| / |dz/dc|, 内部点返回0
+ * 严格来说只在切片里只有c变化时(z_0和X整帧不变)是到边界的距离, 其余情况是c方向上的估计
+ */
+[[nodiscard]] inline Float distance_estimate(const Orbit& orbit, const UInt& max_iterations) {
+    Float distance = 0.F;
+    if_(orbit.iterations_cnt < max_iterations, [&] {
+        Float modulus_square = orbit.z->abs_square();
+        distance = 0.5F * sqrt(modulus_square) * log(modulus_square) / sqrt(orbit.derivative->abs_square());
+    });
+    return distance;
+}
+
+// 内部点按uv着色, 其余按迭代次数的灰度
+[[nodiscard]] inline Float4 shade(const UInt& iterations_cnt, const UInt& max_iterations, const Float2& uv_pos) {
+    Float4 color;
+    if_(iterations_cnt == max_iterations, [&] {
+        color = make_float4(uv_pos, 1.F, 1.F);
+    }).else_([&] {
+        Float grey_level = iterations_cnt.cast<float>() / max_iterations;
+        color = make_float4(make_float3(grey_level), 1.F);
+    });
+    return color;
+}
+
+// 按BYTE4图像的字节顺序(R, G, B, A, 低位在前)打包成一个uint, 用于写到缓冲区而不是图像的kernel
+[[nodiscard]] inline UInt pack_rgba8(const Float4& color) {
+    UInt4 bytes = make_uint4(clamp(color * 255.F + 0.5F, 0.F, 255.F));
+    return bytes.x | (bytes.y << 8u) | (bytes.z << 16u) | (bytes.w << 24u);
+}
+}  // namespace mandelbrot_6d
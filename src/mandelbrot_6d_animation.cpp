@@ -1,12 +1,36 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <luisa/luisa-compute.h>
+#include <optional>
 #include <random>
-#include <stb/stb_image_write.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #define TINYOBJLOADER_IMPLEMENTATION
-#include "common/tiny_obj_loader.h"
-#include "complex.hpp"
-#include "ga.hpp"
+#include "ext/tiny_obj_loader.h"
+#define TINYEXR_IMPLEMENTATION // 要在第一次包含frame_encoder.hpp之前, aov.hpp里也包含了它
+#include "aov.hpp"
+#include "camera_path.hpp"
+#include "deep_zoom.hpp"
+#include "frame_encoder.hpp"
+#include "ga_batch.hpp"
+#include "ga_device.hpp"
+#include "mandelbrot_6d.hpp"
+#include "supersample.hpp"
+#include "tiled_render.hpp"
+#include "vga6.hpp"
+#include "y4m.hpp"
 
 using namespace luisa;
 using namespace luisa::compute;
@@ -78,14 +102,147 @@ Obj loadObj(const std::string& obj_string, Device& device, Stream& stream) {
     return Obj{std::move(accel), std::move(heap)};
 }
 
+/* 渲染循环(逐帧图片和视频流)里每帧的算法: pixel逐像素一次采样, tiled是Mariani-Silver分块渲染(tiled_render.hpp),
+ * aa是自适应超采样抗锯齿(supersample.hpp). 两者互斥: 超采样的第一个pass要算出每个像素, 分块省下的正是这部分.
+ * blur是运动模糊: 快门从这一帧开到下一帧, 每个采样的旋量在kernel里沿路径求值(ga_device.hpp)
+ */
+enum class RenderMode {
+    kPerPixel,
+    kTiled,
+    kSupersample,
+    kMotionBlur
+};
+
+[[nodiscard]] bool parse_render_mode(std::string_view name, RenderMode& mode) {
+    if (name == "pixel") { mode = RenderMode::kPerPixel; return true; }
+    if (name == "tiled") { mode = RenderMode::kTiled; return true; }
+    if (name == "aa") { mode = RenderMode::kSupersample; return true; }
+    if (name == "blur") { mode = RenderMode::kMotionBlur; return true; }
+    return false;
+}
+
+// 标准输入是终端时才能交互地问用户, 重定向或者管道时不能等输入
+[[nodiscard]] bool stdin_is_terminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdin)) != 0;
+#else
+    return isatty(fileno(stdin)) != 0;
+#endif
+}
+
 void test_geo_alg() {
     const vga6::ga_type rotor = vga6::random_rotor();
+
+    // rotor_to_matrix和逐个基向量做三明治积的结果应该一致
+    const float6x6 matrix = vga6::rotor_to_matrix(rotor);
+    const std::array<float6, 6> columns{matrix.col1, matrix.col2, matrix.col3, matrix.col4, matrix.col5, matrix.col6};
+    float max_error = 0;
+    for (size_t col = 0; col < 6; ++col) {
+        std::array<double, 6> basis{};
+        basis[col] = 1;
+        const vga6::ga_type point = vga6::make_ga_point(basis);
+        const vga6::ga_type rotated = (ga_expr::lazy(rotor) * point * ga_expr::lazy(rotor).reverse()).grade(1);
+        const float6 expected = vga6::to_float6(rotated);
+        const float6 actual = columns[col];
+        max_error = std::max({
+            max_error,
+            std::abs(expected.first.x - actual.first.x), std::abs(expected.first.y - actual.first.y),
+            std::abs(expected.first.z - actual.first.z), std::abs(expected.second.x - actual.second.x),
+            std::abs(expected.second.y - actual.second.y), std::abs(expected.second.z - actual.second.z)
+        });
+    }
+    // 误差超过tolerance时直接报错退出
+    const auto check = [](const char *name, double error, double tolerance) {
+        LUISA_INFO("{}的最大误差: {}", name, error);
+        if (!(error <= tolerance)) { LUISA_ERROR("{}的误差{}超过了{}", name, error, tolerance); }
+    };
+    check("rotor_to_matrix与三明治积", max_error, 1e-5);
+
+    // exp(log(R))应该回到R
+    const vga6::ga_type roundtrip = vga6::bivector_exp(vga6::rotor_log(vga6::rotor_type{rotor})).to_full();
+    double log_error = 0;
+    for (size_t idx = 0; idx < vga6::ga_type::kBasesCnt; ++idx) {
+        log_error = std::max(log_error, std::abs(roundtrip.data[idx] - rotor.data[idx]));
+    }
+    check("exp(log(R))与R", log_error, 1e-9);
+
+    const auto max_difference = [](const vga6::ga_type& lhs, const vga6::ga_type& rhs) {
+        double error = 0;
+        for (size_t idx = 0; idx < vga6::ga_type::kBasesCnt; ++idx) {
+            error = std::max(error, std::abs(lhs.data[idx] - rhs.data[idx]));
+        }
+        return error;
+    };
+    const auto plane = [](size_t blade, double angle) {
+        vga6::ga_type result;
+        result.data[0] = std::cos(angle);
+        result.data[blade] = std::sin(angle);
+        return result;
+    };
+    const auto sandwich = [&](const vga6::ga_type& val) { return rotor * val * rotor.reverse(); };
+
+    // 接近等斜的二重向量: 两个或三个平面的角度相差gap, 和逐个平面的指数之积比较
+    double gap_error = 0;
+    for (const double gap: {1e-2, 1e-4, 1e-6, 1e-8, 1e-10, 0.}) {
+        for (const double third: {1.7, 1. - gap}) {
+            const std::array<double, 3> angles{1. + gap, 1., third};
+            vga6::ga_type bivector;
+            bivector.data[0b000011] = angles[0];
+            bivector.data[0b001100] = angles[1];
+            bivector.data[0b110000] = angles[2];
+            const vga6::ga_type expected =
+                plane(0b000011, angles[0]) * plane(0b001100, angles[1]) * plane(0b110000, angles[2]);
+            const vga6::ga_type actual =
+                vga6::bivector_exp(vga6::bivector_type{sandwich(bivector)}).to_full();
+            gap_error = std::max(gap_error, max_difference(actual, sandwich(expected)));
+        }
+    }
+    check("接近等斜时exp", gap_error, 1e-8);
+
+    // 接近等斜的旋量的exp(log(R)): 三个平面的角度相差gap, 包括接近半圈(对数的奇点)和接近R = ±I的情况
+    double isoclinic_error = 0;
+    for (const double gap: {1e-2, 1e-3, 1e-4, 1e-6, 1e-8, 0.}) {
+        for (const double base: {0.4, std::numbers::pi / 2 - 1e-3, std::numbers::pi / 2, std::numbers::pi - 1e-3}) {
+            const vga6::ga_type near_isoclinic = sandwich(
+                plane(0b000011, base + gap) * plane(0b001100, base) * plane(0b110000, base - gap)
+            );
+            const vga6::ga_type actual = vga6::bivector_exp(vga6::rotor_log(vga6::rotor_type{near_isoclinic})).to_full();
+            isoclinic_error = std::max(isoclinic_error, max_difference(actual, near_isoclinic));
+        }
+    }
+    check("接近等斜时exp(log(R))", isoclinic_error, 1e-8);
+
+    // <R>_2 = 0的旋量: 两个或三个平面转半圈, 以及两个半圈加一个任意角度
+    double half_turn_error = 0;
+    for (const vga6::ga_type& half_turn: {
+        plane(0b000011, std::numbers::pi / 2) * plane(0b001100, std::numbers::pi / 2),
+        plane(0b000011, std::numbers::pi / 2) * plane(0b001100, std::numbers::pi / 2) * plane(0b110000, std::numbers::pi / 2),
+        plane(0b000011, std::numbers::pi / 2) * plane(0b001100, std::numbers::pi / 2) * plane(0b110000, 0.7)
+    }) {
+        const vga6::ga_type rotated = sandwich(half_turn);
+        const vga6::ga_type actual = vga6::bivector_exp(vga6::rotor_log(vga6::rotor_type{rotated})).to_full();
+        half_turn_error = std::max(half_turn_error, max_difference(actual, rotated));
+    }
+    check("半圈旋转exp(log(R))", half_turn_error, 1e-9);
+
+    // 样条在t = 0, 1和中间的关键帧处应该正好经过关键帧
+    std::mt19937_64 gen(1);
+    const std::vector<vga6::ga_type> keyframes = camera_path::random_keyframes(gen, 4);
+    const camera_path::RotorSpline spline(keyframes);
+    double spline_error = 0;
+    for (size_t key = 0; key < keyframes.size(); ++key) {
+        const vga6::ga_type rotor_at = spline.at(static_cast<double>(key) / static_cast<double>(keyframes.size() - 1));
+        for (size_t idx = 0; idx < vga6::ga_type::kBasesCnt; ++idx) {
+            spline_error = std::max(spline_error, std::abs(rotor_at.data[idx] - keyframes[key].data[idx]));
+        }
+    }
+    check("相机路径在关键帧处", spline_error, 1e-9);
     exit(0);
 }
 
 int main(int argc, char *argv[]) {
     if (argc <= 1) {
-        LUISA_INFO("Usage: {} <backend>. <backend>: cuda, dx, cpu, metal", argv[0]);
+        LUISA_INFO("Usage: {} <backend> [seed] [camera path file] [png|exr|raw|y4m|bench|preview|aov|recolor|deep] [encoder threads | y4m file, - for stdout] [pixel|tiled|aa|blur]. <backend>: cuda, dx, cpu, metal", argv[0]);
         LUISA_INFO("未输入后端名称， 开始运行测试");
         test_geo_alg();
         exit(1);
@@ -98,81 +255,314 @@ int main(int argc, char *argv[]) {
 
     Kernel2D main_kernel = [&](
         ImageFloat image,
-        const Float6x6& transform_mat,
+        const Float6x6& transform,
         const Float6& translate_vec,
-        UInt max_iterations
+        UInt max_iterations,
+        Float period_tolerance,
+        UInt pow_mode
     ) {
-        /*
-
-        */
         set_block_size(16, 16);
 
         UInt2 img_index = dispatch_id().xy(); // 像素坐标
-        Float2 uv_pos = (make_float2(img_index) + 0.5f) / make_float2(dispatch_size().xy()); // uv坐标
-
-        // 向量(u, v, 0, 0, 0, 0)先乘矩阵然后移动
-        Float6 pos = transform_mat * def<float6>(
-            make_float3(uv_pos - make_float2(0.5, 0.5), 0.F),
-            make_float3(0)
-        ) + translate_vec;
-
-        /*
-        mandelbrot集扩展, 是六维结构
-        迭代公式: Z_{n+1} = (Z_n)^X+C
-        其中Z_n, X, C都是复数
-        */
-        Complex mb_z{pos.first.x, pos.first.y};
-        Complex original_z = mb_z;
-        Complex mb_x{pos.first.z, pos.second.x};
-        Complex mb_c{pos.second.y, pos.second.z};
-
-        // 迭代
-        UInt iterations_cnt = 0;
-        for (auto iterate_idx: dynamic_range(max_iterations)) {
-            iterations_cnt += 1;
-            if_((mb_z - original_z)->abs_square() > 1000, break_);
-
-            mb_z = mb_z->pow(mb_x) + mb_c;
+        Float2 uv_pos = mandelbrot_6d::pixel_uv(img_index, dispatch_size().xy()); // uv坐标
+        Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+        UInt iterations_cnt = mandelbrot_6d::iterate(pos, max_iterations, period_tolerance, pow_mode);
+        image.write(img_index, mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos));
+    };
+    Shader main_shader = device.compile(main_kernel);
+
+    /* 运动模糊: 每个像素samples次采样, 第k个采样在快门时间(k + 0.5) / samples. 旋量由ga_device::rotor_path_at在kernel里求值,
+     * 每个采样的旋转都不同, 不能用host上算好的矩阵. 缩放和平移同CameraPath
+     */
+    Kernel2D blur_kernel = [&](
+        ImageFloat image,
+        const RotorPath6& rotor_path,
+        Float scale,
+        const Float6& translate_vec,
+        UInt max_iterations,
+        Float period_tolerance,
+        UInt pow_mode,
+        UInt samples
+    ) {
+        set_block_size(16, 16);
+
+        UInt2 img_index = dispatch_id().xy();
+        Float2 uv_pos = mandelbrot_6d::pixel_uv(img_index, dispatch_size().xy());
+        Float6 point = def<float6>(make_float3(uv_pos - make_float2(0.5, 0.5), 0.F), make_float3(0));
+        Float4 color_sum = make_float4(0.F);
+        for (auto sample_idx: dynamic_range(samples)) {
+            Float shutter_t = (sample_idx.cast<float>() + 0.5F) / samples.cast<float>();
+            Rotor6 rotor = ga_device::rotor_path_at(rotor_path, shutter_t);
+            Float6 pos = ga_device::sandwich(rotor, point) * scale + translate_vec;
+            UInt iterations_cnt = mandelbrot_6d::iterate(pos, max_iterations, period_tolerance, pow_mode);
+            color_sum += mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos);
         };
+        image.write(img_index, color_sum / samples.cast<float>());
+    };
+    Shader blur_shader = device.compile(blur_kernel);
+
+    /* 一次dispatch渲染多帧: dispatch_id().z是批内的帧号, 每帧的变换, 平移和z^X的算法从缓冲区读,
+     * 结果按BYTE4图像的字节顺序打包, 各帧依次排在pixels里. 用于低分辨率的预览, 省掉逐帧的dispatch和同步
+     */
+    Kernel3D batch_kernel = [&](
+        BufferUInt pixels,
+        BufferVar<float6x6> transforms,
+        BufferVar<float6> translates,
+        BufferUInt pow_modes,
+        UInt max_iterations,
+        Float period_tolerance
+    ) {
+        set_block_size(16, 16, 1);
+
+        UInt3 index = dispatch_id();
+        UInt2 size = dispatch_size().xy();
+        Float2 uv_pos = mandelbrot_6d::pixel_uv(index.xy(), size);
+        Float6 pos = mandelbrot_6d::sample_position(uv_pos, transforms.read(index.z), translates.read(index.z));
+        UInt iterations_cnt = mandelbrot_6d::iterate(pos, max_iterations, period_tolerance, pow_modes.read(index.z));
+        Float4 color = mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos);
+        pixels.write((index.z * size.y + index.y) * size.x + index.x, mandelbrot_6d::pack_rgba8(color));
+    };
+    Shader batch_shader = device.compile(batch_kernel);
 
-        Float grey_level;
-        Float4 color;
-        if_(iterations_cnt == max_iterations, [&] {
-            color = make_float4(uv_pos, 1.F, 1.F);
-        }).else_([&] {
-            grey_level = iterations_cnt.cast<float>() / max_iterations;
-            color = make_float4(make_float3(grey_level), 1.F);
-        });
-        image.write(img_index, color);
+    // 只写AOV(见aov.hpp), 不着色
+    Kernel2D aov_kernel = [&](
+        BufferFloat aovs,
+        const Float6x6& transform,
+        const Float6& translate_vec,
+        UInt max_iterations,
+        Float period_tolerance,
+        UInt pow_mode,
+        Float c_pixel_size
+    ) {
+        set_block_size(16, 16);
+
+        UInt2 img_index = dispatch_id().xy();
+        UInt2 size = dispatch_size().xy();
+        Float2 uv_pos = mandelbrot_6d::pixel_uv(img_index, size);
+        Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+        mandelbrot_6d::Orbit orbit = mandelbrot_6d::iterate_orbit(pos, max_iterations, period_tolerance, pow_mode);
+        aov::store(aovs, img_index.y * size.x + img_index.x, size.x * size.y, pos, orbit, max_iterations, c_pixel_size);
     };
-    Shader main_shader = device.compile(main_kernel);
+    Shader aov_shader = device.compile(aov_kernel);
 
-    // RNG
-    std::random_device seed;
-    std::mt19937 engine(seed());
+    // 从AOV着色, 没有迭代, 换调色板时只需要重新跑这个
+    Kernel2D recolor_kernel = [&](
+        BufferFloat aovs,
+        ImageFloat image,
+        Float max_iterations,
+        const CosinePalette& palette
+    ) {
+        set_block_size(16, 16);
+
+        UInt2 img_index = dispatch_id().xy();
+        UInt2 size = dispatch_size().xy();
+        image.write(img_index, aov::shade(aovs, img_index.y * size.x + img_index.x, size.x * size.y, max_iterations, palette));
+    };
+    Shader recolor_shader = device.compile(recolor_kernel);
+
+    // 转成YUV420, 拷回host的就是可以直接写进视频流的数据
+    Kernel2D yuv_kernel = [&](ImageFloat image, BufferUInt yuv) {
+        set_block_size(16, 8);
+        y4m::convert_block(image, yuv);
+    };
+    Shader yuv_shader = device.compile(yuv_kernel);
+
+    // RNG. 不指定种子时随机取一个并打印出来, 下次可以用同一个种子复现
+    const std::uint64_t seed = argc > 2 ? std::stoull(argv[2]) : std::random_device{}();
+    LUISA_INFO("seed: {}", seed);
+    std::mt19937 engine(static_cast<std::mt19937::result_type>(seed));
     std::uniform_real_distribution<float> distribution(-1, .1);
 
     // 初始设置
     constexpr size_t kImageWidth =  1024;
     constexpr size_t kImageHeight = 1024;
     constexpr uint kRenderTimes = 1000;
+    constexpr uint kMaxIterations = 512;
+    constexpr float kPeriodTolerance = 1e-5F; // 周期检测的容差, 0关闭
     const filesystem::path file_save_path = filesystem::current_path() / "output";
-    const vga6::ga_type rotor_start = vga6::random_rotor();
-    const vga6::ga_type rotor_end = vga6::random_rotor();
-    constexpr float mat_coeff = 10.; // 旋转矩阵的系数
-    float6 translate_vec = make_float6(
-        #define R distribution(engine) * 2.
-        R, R, R, R, R, R
-        #undef R
-    );
-    const std::array<vga6::ga_type, 6> ga_basis{
-        vga6::make_ga_point({1, 0, 0, 0, 0, 0}),
-        vga6::make_ga_point({0, 1, 0, 0, 0, 0}),
-        vga6::make_ga_point({0, 0, 1, 0, 0, 0}),
-        vga6::make_ga_point({0, 0, 0, 1, 0, 0}),
-        vga6::make_ga_point({0, 0, 0, 0, 1, 0}),
-        vga6::make_ga_point({0, 0, 0, 0, 0, 1})
+    const filesystem::path aov_save_path = filesystem::current_path() / "aov"; // 和output分开, 重新着色时不会被清掉
+    // 所有帧的变换一次算好, 同样的参数再次渲染时直接从文件读
+    const camera_path::Settings path_settings{
+        .seed = seed,
+        .keyframes = 4,
+        .frames = kRenderTimes,
+        .scale = 10.F // 旋转之后的缩放系数
     };
+    const filesystem::path camera_path_file = argc > 3 ? filesystem::path(argv[3]) : filesystem::current_path() / "camera_path.bin";
+    const camera_path::CameraPath path = camera_path::load_or_make(path_settings, camera_path_file);
+
+    tiled_render::TiledRenderer tiled_renderer(device, stream, kImageWidth, kImageHeight);
+    supersample::AdaptiveSupersampler supersampler(device, kImageWidth, kImageHeight);
+
+    /* 吞吐量测试: 比较周期检测开关, 逐像素和分块渲染时的Mpix/s, 并统计分块渲染和逐像素结果不同的像素数.
+     * 一帧全是内部点(x = 2, 就是z^2 + c, z在吸引不动点附近, 也用来比较整数次幂的快速路径), 一帧取路径中间的变换.
+     * 最后在路径的那一帧上比较自适应超采样和均匀超采样
+     */
+    if (argc > 4 && std::string_view(argv[4]) == "bench") {
+        constexpr uint kBenchFrames = 16;
+        Image<float> bench_image = device.create_image<float>(PixelStorage::BYTE4, kImageWidth, kImageHeight);
+        std::vector<std::byte> per_pixel_pixels(kImageWidth * kImageHeight * 4);
+        std::vector<std::byte> tiled_pixels(kImageWidth * kImageHeight * 4);
+        float6x6 interior_transform{};
+        interior_transform.col1 = make_float6(1, 0, 0, 0, 0, 0);
+        interior_transform.col2 = make_float6(0, 1, 0, 0, 0, 0);
+        struct BenchCase {
+            const char* name;
+            float6x6 transform;
+            float6 translate;
+        };
+        const std::array<BenchCase, 2> cases{
+            BenchCase{"interior", interior_transform, make_float6(0, 0, 2, 0, -.1F, .1F)},
+            BenchCase{"path", path.transforms[kRenderTimes / 2], path.translate}
+        };
+        // 提交kBenchFrames帧(之前先预热一帧), 返回Mpix/s
+        const auto measure = [&](const auto& render_frame) {
+            render_frame();
+            stream << synchronize();
+            const auto start = std::chrono::steady_clock::now();
+            for (uint frame = 0; frame < kBenchFrames; ++frame) { render_frame(); }
+            stream << synchronize();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return static_cast<double>(kImageWidth * kImageHeight * kBenchFrames) / elapsed.count() * 1e-6;
+        };
+        for (const BenchCase& bench_case : cases) {
+            const mandelbrot_6d::PowMode pow_mode = mandelbrot_6d::choose_pow_mode(bench_case.transform, bench_case.translate);
+            for (const float tolerance : {0.F, kPeriodTolerance}) {
+                const auto per_pixel_rate = [&](mandelbrot_6d::PowMode mode) {
+                    return measure([&] {
+                        stream << main_shader(
+                            bench_image, bench_case.transform, bench_case.translate, kMaxIterations, tolerance,
+                            static_cast<uint>(mode)
+                        ).dispatch(kImageWidth, kImageHeight);
+                    });
+                };
+                const double pixel_rate = per_pixel_rate(pow_mode);
+                stream << bench_image.copy_to(per_pixel_pixels.data());
+                const double tiled_rate = measure([&] {
+                    tiled_renderer.render(stream, bench_image, bench_case.transform, bench_case.translate, kMaxIterations, tolerance);
+                });
+                stream << bench_image.copy_to(tiled_pixels.data()) << synchronize();
+
+                size_t mismatched = 0;
+                for (size_t pixel = 0; pixel < kImageWidth * kImageHeight; ++pixel) {
+                    mismatched += !std::equal(
+                        per_pixel_pixels.begin() + pixel * 4, per_pixel_pixels.begin() + pixel * 4 + 4, tiled_pixels.begin() + pixel * 4
+                    );
+                }
+                LUISA_INFO(
+                    "{} frame, period tolerance {}: per-pixel {:.1f} Mpix/s, tiled {:.1f} Mpix/s, {} pixel(s) differ",
+                    bench_case.name, tolerance, pixel_rate, tiled_rate, mismatched
+                );
+                // X是整帧常数时(比如标准的z^2 + c切片)和一般的复数次幂比较
+                if (pow_mode != mandelbrot_6d::PowMode::kComplex) {
+                    LUISA_INFO(
+                        "{} frame, period tolerance {}: per-pixel with general complex pow {:.1f} Mpix/s",
+                        bench_case.name, tolerance, per_pixel_rate(mandelbrot_6d::PowMode::kComplex)
+                    );
+                }
+            }
+        }
+
+        // 自适应超采样和同样采样网格的均匀超采样比较: 速度, 平均每像素的采样数, 两者相差超过2/255的通道值数.
+        // 两个像素缓冲区这里分别装均匀和自适应的结果
+        const BenchCase& path_case = cases[1];
+        const auto supersample_rate = [&](bool uniform) {
+            return measure([&] {
+                supersampler.render(
+                    stream, bench_image, path_case.transform, path_case.translate, kMaxIterations, kPeriodTolerance, uniform
+                );
+            });
+        };
+        const double uniform_rate = supersample_rate(true);
+        stream << bench_image.copy_to(per_pixel_pixels.data());
+        const double adaptive_rate = supersample_rate(false);
+        stream << bench_image.copy_to(tiled_pixels.data()) << synchronize();
+        const double samples_per_pixel =
+            1. + static_cast<double>(supersampler.refined_count(stream)) * supersampler.samples_per_refined_pixel()
+            / static_cast<double>(kImageWidth * kImageHeight);
+        size_t mismatched = 0;
+        for (size_t byte = 0; byte < per_pixel_pixels.size(); ++byte) {
+            const int difference =
+                std::to_integer<int>(per_pixel_pixels[byte]) - std::to_integer<int>(tiled_pixels[byte]);
+            mismatched += std::abs(difference) > 2;
+        }
+        LUISA_INFO(
+            "path frame, supersampling: uniform {} spp {:.1f} Mpix/s, adaptive {:.2f} spp {:.1f} Mpix/s, {} channel value(s) differ",
+            supersampler.samples_per_refined_pixel() + 1, uniform_rate, samples_per_pixel, adaptive_rate, mismatched
+        );
+        return 0;
+    }
+
+    /* 输出方式: 逐帧图片(png, exr, raw), 第5个参数是编码线程数, 为0时按硬件线程数;
+     * 或者一个YUV4MPEG2视频流(y4m), 第5个参数是文件名, "-"表示标准输出, 这时进度信息打印到标准错误;
+     * 或者低分辨率的预览(preview), 按批渲染, 写png, 第5个参数同样是编码线程数;
+     * 或者只写AOV(aov)到aov目录, 之后用recolor从AOV着色写png, 第5个参数同样是编码线程数;
+     * 或者深度放大(deep), 写png, 第5个参数同样是编码线程数
+     */
+    const bool video_mode = argc > 4 && std::string_view(argv[4]) == "y4m";
+    const bool preview_mode = argc > 4 && std::string_view(argv[4]) == "preview";
+    const bool aov_mode = argc > 4 && std::string_view(argv[4]) == "aov";
+    const bool recolor_mode = argc > 4 && std::string_view(argv[4]) == "recolor";
+    const bool deep_mode = argc > 4 && std::string_view(argv[4]) == "deep";
+    frame_encoder::Format frame_format = frame_encoder::Format::kPng;
+    if (
+        argc > 4 && !video_mode && !preview_mode && !aov_mode && !recolor_mode && !deep_mode
+        && !frame_encoder::parse_format(argv[4], frame_format)
+    ) {
+        LUISA_ERROR("Unknown frame format: {}", argv[4]);
+    }
+    const size_t encoder_threads = argc > 5 && !video_mode ? std::stoull(argv[5]) : 0;
+    const std::string video_file = argc > 5 ? std::string(argv[5]) : (file_save_path / "animation.y4m").string();
+    std::ostream& progress = video_mode && video_file == "-" ? std::cerr : std::cout;
+    // 第6个参数选渲染循环的算法, 见RenderMode, 默认抗锯齿
+    RenderMode render_mode = RenderMode::kSupersample;
+    if (argc > 6 && !parse_render_mode(argv[6], render_mode)) {
+        LUISA_ERROR("Unknown render mode: {}", argv[6]);
+    }
+
+    /* AOV: 和逐帧图片一样按路径顺序渲染, 帧从0编号. 设备缓冲区和拷回的数组各两份交替使用,
+     * 第n帧拷回后才把它交给编码器, 这时第n + 1帧已经在设备上渲染
+     */
+    if (aov_mode) {
+        constexpr size_t kAovFloats = aov::frame_floats(kImageWidth, kImageHeight);
+        if (filesystem::exists(aov_save_path)) {
+            filesystem::remove_all(aov_save_path);
+        }
+        filesystem::create_directory(aov_save_path);
+        std::array<Buffer<float>, 2> aov_buffers{
+            device.create_buffer<float>(kAovFloats), device.create_buffer<float>(kAovFloats)
+        };
+        std::array<std::vector<std::byte>, 2> aov_pixels;
+        frame_encoder::FrameEncoder aov_encoder(frame_encoder::Format::kAov, encoder_threads, 4);
+        TimelineEvent aov_ready = device.create_timeline_event();
+        const auto hand_off_aov = [&](uint frame) {
+            aov_ready.synchronize(frame + 1);
+            const filesystem::path file = aov_save_path / (std::to_string(frame) + ".exr");
+            progress << file.string() << "\n";
+            aov_encoder.submit(frame_encoder::Frame{
+                file, kImageWidth, kImageHeight, std::move(aov_pixels[frame % 2]), aov::kChannelNames
+            });
+        };
+
+        for (uint frame = 0; frame < kRenderTimes; ++frame) {
+            const float6x6& transform = path.transforms[frame];
+            const auto pow_mode = static_cast<uint>(mandelbrot_6d::choose_pow_mode(transform, path.translate));
+            std::vector<std::byte>& pixels = aov_pixels[frame % 2];
+            pixels = aov_encoder.take_buffer(kAovFloats * sizeof(float));
+            stream
+                << aov_shader(
+                    aov_buffers[frame % 2], transform, path.translate, kMaxIterations, kPeriodTolerance, pow_mode,
+                    mandelbrot_6d::c_pixel_size(transform, kImageWidth, kImageHeight)
+                ).dispatch(kImageWidth, kImageHeight)
+                << aov_buffers[frame % 2].copy_to(pixels.data())
+                << aov_ready.signal(frame + 1);
+            if (frame > 0) { hand_off_aov(frame - 1); }
+        }
+        hand_off_aov(kRenderTimes - 1);
+        aov_encoder.wait();
+        if (aov_encoder.failures() != 0) { LUISA_WARNING("{} frame(s) failed to write", aov_encoder.failures()); }
+        return 0;
+    }
 
     // 删除已有文件
     if (filesystem::exists(file_save_path)) {
@@ -180,69 +570,320 @@ int main(int argc, char *argv[]) {
     }
     filesystem::create_directory(file_save_path);
 
-    // 渲染循环
-    for (uint render_cnt = 0; render_cnt < kRenderTimes; ++render_cnt) {
-        uint render_index = render_cnt;
-        if (render_index == 0) { render_index = kRenderTimes; }
+    // 输出合成视频的命令, 原始格式要告诉ffmpeg像素格式和尺寸
+    const auto print_ffmpeg_command = [&](size_t width, size_t height) {
+        std::cout << "ffmpeg -f image2";
+        if (frame_format == frame_encoder::Format::kRaw) {
+            std::cout << " -c:v rawvideo -pixel_format rgba -video_size " << width << "x" << height;
+        }
+        std::cout
+            << " -i"
+            << " \"" << (file_save_path / ("%d." + std::string(frame_encoder::extension(frame_format)))).string() << "\""
+            << " -vcodec libx264"
+            << " -pix_fmt yuv420p -movflags +faststart -framerate 60"
+            << " \"" << (filesystem::current_path() / "_111.mp4").string() << "\"";
+    };
 
-        #define R distribution(engine)
-        float render_t = static_cast<float>(render_index) / (kRenderTimes - 1);
-        auto current_rotor = vga6::rotor_lerp(rotor_start, rotor_end, render_t);
-        float6x6 transform_mat{
-            // 将rotor作用于六个基向量
-            #define MAKE_BASE_VEC(basis_idx) \
-                vga6::to_float6( \
-                    current_rotor * ga_basis[basis_idx] \
-                        * current_rotor.reverse() * mat_coeff \
-                )
-            .col1=MAKE_BASE_VEC(0),
-            .col2=MAKE_BASE_VEC(1),
-            .col3=MAKE_BASE_VEC(2),
-            .col4=MAKE_BASE_VEC(3),
-            .col5=MAKE_BASE_VEC(4),
-            .col6=MAKE_BASE_VEC(5)
-            #undef MAKE_BASE_VEC
+    /* 从aov目录里的AOV重新着色: 每批kRecolorBatch帧在多个线程上并行读文件(解压EXR是主要的耗时),
+     * 然后逐帧上传, 着色, 拷回, 交给编码器写png. 调色板见aov::default_palette
+     */
+    if (recolor_mode) {
+        constexpr uint kRecolorBatch = 16;
+        constexpr size_t kFrameBytes = kImageWidth * kImageHeight * 4;
+        const cosine_palette palette = aov::default_palette();
+        Buffer<float> aov_buffer = device.create_buffer<float>(aov::frame_floats(kImageWidth, kImageHeight));
+        Image<float> image = device.create_image<float>(PixelStorage::BYTE4, kImageWidth, kImageHeight);
+        std::vector<std::vector<float>> loaded(kRecolorBatch);
+        std::vector<char> load_success(kRecolorBatch);
+        frame_encoder::FrameEncoder recolor_encoder(frame_format, encoder_threads, 2 * kRecolorBatch);
+
+        const auto start = std::chrono::steady_clock::now();
+        uint recolored_cnt = 0;
+        for (uint first = 0; first < kRenderTimes; first += kRecolorBatch) {
+            const uint count = std::min(kRecolorBatch, kRenderTimes - first);
+            ga_batch::parallel_for(count, 1, [&](size_t begin, size_t end) {
+                for (size_t frame = begin; frame < end; ++frame) {
+                    const filesystem::path file = aov_save_path / (std::to_string(first + frame) + ".exr");
+                    load_success[frame] = aov::load(file, kImageWidth, kImageHeight, loaded[frame]);
+                }
+            });
+            for (uint frame = 0; frame < count && load_success[frame]; ++frame, ++recolored_cnt) {
+                std::vector<std::byte> pixels = recolor_encoder.take_buffer(kFrameBytes);
+                stream
+                    << aov_buffer.copy_from(loaded[frame].data())
+                    << recolor_shader(aov_buffer, image, static_cast<float>(kMaxIterations), palette)
+                        .dispatch(kImageWidth, kImageHeight)
+                    << image.copy_to(pixels.data())
+                    << synchronize();
+                recolor_encoder.submit(frame_encoder::Frame{
+                    file_save_path / (std::to_string(first + frame) + ".png"), kImageWidth, kImageHeight, std::move(pixels)
+                });
+            }
+            if (recolored_cnt != first + count) {
+                LUISA_WARNING("Failed to load AOV frame {} from {}", recolored_cnt, aov_save_path.string());
+                break;
+            }
+        }
+        recolor_encoder.wait();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        LUISA_INFO("recolor: {} frame(s) in {:.2f} s", recolored_cnt, elapsed.count());
+        if (recolor_encoder.failures() != 0) { LUISA_WARNING("{} frame(s) failed to write", recolor_encoder.failures()); }
+        print_ffmpeg_command(kImageWidth, kImageHeight);
+        return 0;
+    }
+
+    /* 预览: 每批kPreviewBatch帧的变换一起上传, 一次3D dispatch渲染, 一次拷回和同步, 再逐帧交给编码器.
+     * 帧按路径顺序从0编号
+     */
+    if (preview_mode) {
+        constexpr size_t kPreviewSize = 256;
+        constexpr uint kPreviewBatch = 64;
+        constexpr size_t kPreviewPixels = kPreviewSize * kPreviewSize;
+        Buffer<float6x6> transforms_buffer = device.create_buffer<float6x6>(kPreviewBatch);
+        Buffer<float6> translates_buffer = device.create_buffer<float6>(kPreviewBatch);
+        Buffer<uint> pow_modes_buffer = device.create_buffer<uint>(kPreviewBatch);
+        Buffer<uint> pixels_buffer = device.create_buffer<uint>(kPreviewPixels * kPreviewBatch);
+        const std::vector<float6> translates(kPreviewBatch, path.translate);
+        std::vector<uint> pow_modes(kPreviewBatch);
+        std::vector<std::byte> batch_pixels(kPreviewPixels * kPreviewBatch * 4);
+        frame_encoder::FrameEncoder preview_encoder(frame_format, encoder_threads, 2 * kPreviewBatch);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (uint first = 0; first < kRenderTimes; first += kPreviewBatch) {
+            const uint count = std::min(kPreviewBatch, kRenderTimes - first);
+            for (uint frame = 0; frame < count; ++frame) {
+                pow_modes[frame] = static_cast<uint>(mandelbrot_6d::choose_pow_mode(path.transforms[first + frame], path.translate));
+            }
+            stream
+                << transforms_buffer.view(0, count).copy_from(path.transforms.data() + first)
+                << translates_buffer.view(0, count).copy_from(translates.data())
+                << pow_modes_buffer.view(0, count).copy_from(pow_modes.data())
+                << batch_shader(
+                    pixels_buffer, transforms_buffer, translates_buffer, pow_modes_buffer, kMaxIterations, kPeriodTolerance
+                ).dispatch(kPreviewSize, kPreviewSize, count)
+                << pixels_buffer.view(0, kPreviewPixels * count).copy_to(batch_pixels.data())
+                << synchronize();
+            for (uint frame = 0; frame < count; ++frame) {
+                std::vector<std::byte> pixels = preview_encoder.take_buffer(kPreviewPixels * 4);
+                const auto frame_begin = batch_pixels.begin() + static_cast<std::ptrdiff_t>(kPreviewPixels * 4 * frame);
+                std::copy(frame_begin, frame_begin + static_cast<std::ptrdiff_t>(kPreviewPixels * 4), pixels.begin());
+                preview_encoder.submit(frame_encoder::Frame{
+                    file_save_path / (std::to_string(first + frame) + "." + std::string(frame_encoder::extension(frame_format))),
+                    kPreviewSize, kPreviewSize, std::move(pixels)
+                });
+            }
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        LUISA_INFO(
+            "preview: {} frame(s) of {}x{} in {:.2f} s, {:.1f} Mpix/s", kRenderTimes, kPreviewSize, kPreviewSize,
+            elapsed.count(), static_cast<double>(kPreviewPixels * kRenderTimes) / elapsed.count() * 1e-6
+        );
+        preview_encoder.wait();
+        if (preview_encoder.failures() != 0) { LUISA_WARNING("{} frame(s) failed to write", preview_encoder.failures()); }
+        print_ffmpeg_command(kPreviewSize, kPreviewSize);
+        return 0;
+    }
+
+    /* 深度放大: 画面取路径第一帧的平面(X固定为kDeepExponent), 中心在画面中线上找到的集合边界上,
+     * 逐帧按指数缩小到kDeepZoom. 参考轨道只在开始时算一次.
+     * 和下面的渲染循环一样按kDeepRingSize份槽位流水线化: 每帧的毛刺像素数写到槽位自己的计数器,
+     * 和像素一起拷回, 等同一个时间线事件, 不再每帧同步
+     */
+    if (deep_mode) {
+        constexpr uint kDeepMaxIterations = 4096;
+        constexpr uint kDeepExponent = 2;
+        constexpr double kDeepZoom = 1e-25; // 最后一帧相对第一帧的缩放
+        constexpr uint kDeepRingSize = 3;
+        constexpr size_t kFrameBytes = kImageWidth * kImageHeight * 4;
+        deep_zoom::DeepZoomRenderer deep_renderer(device, kDeepMaxIterations, kDeepRingSize);
+        // 中心按一半的迭代次数找, 放大之后边界附近的像素还有余量逃逸
+        deep_renderer.set_view(
+            stream, deep_zoom::make_view(path.transforms[0], path.translate, kDeepExponent, kDeepMaxIterations / 2)
+        );
+        LUISA_INFO(
+            "deep zoom: reference orbit {} iteration(s), critical orbit {} iteration(s)",
+            deep_renderer.reference_length(), deep_renderer.critical_length()
+        );
+        struct DeepSlot {
+            Image<float> image;
+            std::vector<std::byte> pixels;
+            uint glitches = 0; // 拷回的毛刺像素数
         };
+        std::vector<DeepSlot> deep_slots;
+        deep_slots.reserve(kDeepRingSize);
+        for (uint slot = 0; slot < kDeepRingSize; ++slot) {
+            deep_slots.push_back(DeepSlot{device.create_image<float>(PixelStorage::BYTE4, kImageWidth, kImageHeight)});
+        }
+        frame_encoder::FrameEncoder deep_encoder(frame_format, encoder_threads, 2 * kDeepRingSize);
+        // 第n帧的像素和毛刺数都拷回host之后信号值变成n + 1
+        TimelineEvent deep_ready = device.create_timeline_event();
+        const auto frame_scale = [&](uint frame) {
+            const double progress_ratio = static_cast<double>(frame) / static_cast<double>(kRenderTimes - 1);
+            return static_cast<float>(std::pow(kDeepZoom, progress_ratio));
+        };
+        const auto hand_off_deep = [&](uint frame) {
+            deep_ready.synchronize(frame + 1);
+            DeepSlot& slot = deep_slots[frame % kDeepRingSize];
+            const filesystem::path file =
+                file_save_path / (std::to_string(frame) + "." + std::string(frame_encoder::extension(frame_format)));
+            progress << file.string() << " (scale " << frame_scale(frame) << ", " << slot.glitches << " glitched pixel(s))\n";
+            deep_encoder.submit(frame_encoder::Frame{file, kImageWidth, kImageHeight, std::move(slot.pixels)});
+        };
+
+        uint handed_cnt = 0;
+        for (uint frame = 0; frame < kRenderTimes; ++frame) {
+            // 槽位上一次装的第frame - kDeepRingSize帧已经在上一轮交出
+            DeepSlot& slot = deep_slots[frame % kDeepRingSize];
+            slot.pixels = deep_encoder.take_buffer(kFrameBytes);
+            deep_renderer.render(stream, slot.image, frame_scale(frame), frame % kDeepRingSize);
+            stream << slot.image.copy_to(slot.pixels.data());
+            deep_renderer.copy_glitch_count(stream, frame % kDeepRingSize, slot.glitches);
+            stream << deep_ready.signal(frame + 1);
+            if (frame + 1 >= kDeepRingSize) { hand_off_deep(handed_cnt++); }
+        }
+        while (handed_cnt < kRenderTimes) { hand_off_deep(handed_cnt++); }
+        deep_encoder.wait();
+        if (deep_encoder.failures() != 0) { LUISA_WARNING("{} frame(s) failed to write", deep_encoder.failures()); }
+        print_ffmpeg_command(kImageWidth, kImageHeight);
+        return 0;
+    }
+
+    /* 渲染循环, 流水线化: 主线程提交第n帧后, 等第n - (kRingSize - 1)帧拷回, 把它的像素缓冲区交给编码器,
+     * 编码器的多个线程并行写文件. 图像按环形复用kRingSize份, 像素缓冲区随帧交出, 写完后由编码器回收再取回来用.
+     * 编码器的队列满了时submit会阻塞, 渲染就等编码(背压).
+     * 视频流模式下拷回的是设备上转好的YUV420, 主线程直接按顺序写出, 缓冲区留在槽位里
+     */
+    constexpr uint kRingSize = 3;
+    constexpr size_t kFrameBytes = kImageWidth * kImageHeight * 4;
+    constexpr uint kBlurSamples = 8; // blur模式每个像素的采样数
+    // blur模式在kernel里沿旋量路径求值, 要用样条本身而不只是每帧的矩阵. 只有几次log和exp
+    const camera_path::RotorSpline spline = camera_path::make_spline(path_settings);
+    struct FrameSlot {
+        Image<float> image;
+        Buffer<uint> yuv; // 只在视频流模式下创建
+        std::vector<std::byte> pixels;
+    };
+    std::vector<FrameSlot> slots;
+    slots.reserve(kRingSize);
+    for (uint slot = 0; slot < kRingSize; ++slot) {
+        slots.push_back(FrameSlot{
+            device.create_image<float>(PixelStorage::BYTE4, kImageWidth, kImageHeight),
+            video_mode ? device.create_buffer<uint>(y4m::frame_words(kImageWidth, kImageHeight)) : Buffer<uint>{},
+            video_mode ? std::vector<std::byte>(y4m::frame_bytes(kImageWidth, kImageHeight)) : std::vector<std::byte>{}
+        });
+    }
+    std::optional<frame_encoder::FrameEncoder> encoder;
+    std::optional<y4m::Writer> video;
+    if (video_mode) {
+        video.emplace(video_file, kImageWidth, kImageHeight);
+        if (!video->is_open()) { LUISA_ERROR("Failed to open video file: {}", video_file); }
+    } else {
+        encoder.emplace(frame_format, encoder_threads, 2 * kRingSize);
+    }
+    // 第n帧(从0数)拷回host之后信号值变成n + 1
+    TimelineEvent frame_ready = device.create_timeline_event();
+    const auto frame_file = [&](uint render_index) {
+        return file_save_path / (std::to_string(render_index) + "." + std::string(frame_encoder::extension(frame_format)));
+    };
+    const auto to_render_index = [](uint render_cnt) { return render_cnt == 0 ? kRenderTimes : render_cnt; };
+
+    // 第4帧时问一次是否继续. 视频流模式是无人值守地输出整段视频, 标准输入不是终端时也没人回答, 都不问
+    const bool ask_to_continue = !video_mode && stdin_is_terminal();
+    // 等第render_cnt帧拷回并交给编码器(或者写进视频流), 用户选择不继续或者写失败时返回false
+    const auto hand_off = [&](uint render_cnt) {
+        frame_ready.synchronize(render_cnt + 1);
+        const uint render_index = to_render_index(render_cnt);
+        if (video_mode) {
+            progress << "frame " << render_cnt << "\n";
+        } else {
+            progress << frame_file(render_index).string().data() << "\n";
+        }
+
+        char inp = 'n';
+        if (render_index == 4 && ask_to_continue) {
+            progress << "want to continue(y/N)? ";
+            std::cin >> inp;
+            if (inp != 'y' && inp != 'Y') { return false; }
+        }
+        if (video_mode) {
+            if (!video->write_frame(slots[render_cnt % kRingSize].pixels)) {
+                LUISA_WARNING("Failed to write video frame {}", render_cnt);
+                return false;
+            }
+            return true;
+        }
+        encoder->submit(frame_encoder::Frame{
+            frame_file(render_index), kImageWidth, kImageHeight, std::move(slots[render_cnt % kRingSize].pixels)
+        });
+        return true;
+    };
+
+    bool stopped = false;
+    uint handed_cnt = 0; // 已经交给编码器的帧数
+    for (uint render_cnt = 0; render_cnt < kRenderTimes && !stopped; ++render_cnt) {
+        const uint render_index = to_render_index(render_cnt);
+
+        #define R distribution(engine)
         auto mb_z = complex(2, R);
         #undef R
 
-        std::vector<std::byte> pixels{kImageWidth * kImageHeight * 4};
-        Image<float> image = device.create_image<float>(PixelStorage::BYTE4, kImageWidth, kImageHeight);
-        stream
-            << main_shader(
-                image,
-                transform_mat,
-                translate_vec,
-                512
-            ).dispatch(kImageWidth, kImageHeight)
-            << image.copy_to(pixels.data())
-            << synchronize();
-
-        std::cout << (
-            file_save_path / (std::to_string(render_index) + std::string(".png"))
-        ).string().data() << "\n";
-
-        char inp;
-        if (render_index == 4) {
-            std::cout << "want to continue(y/N)? ";
-            std::cin >> inp;
-            if (inp != 'y' && inp != 'Y') { exit(0); }
+        // 槽位上一次装的第render_cnt - kRingSize帧已经在上一轮交出. 视频流按提交顺序播放, 直接用第render_cnt帧的变换
+        FrameSlot& slot = slots[render_cnt % kRingSize];
+        const uint transform_index = video_mode ? render_cnt : std::min(render_index, kRenderTimes - 1);
+        if (render_mode == RenderMode::kSupersample) {
+            supersampler.render(stream, slot.image, path.transforms[transform_index], path.translate, kMaxIterations, kPeriodTolerance);
+        } else if (render_mode == RenderMode::kTiled) {
+            tiled_renderer.render(stream, slot.image, path.transforms[transform_index], path.translate, kMaxIterations, kPeriodTolerance);
+        } else if (render_mode == RenderMode::kMotionBlur) {
+            // 这一帧到下一帧的旋量路径. 快门内X可能变化, 两端选出的z^X算法不同时按一般的复数次幂
+            const uint next_index = std::min(transform_index + 1, kRenderTimes - 1);
+            const rotor_path6 rotor_path = ga_device::make_rotor_path(
+                spline.at(camera_path::frame_t(path_settings, transform_index)),
+                spline.at(camera_path::frame_t(path_settings, next_index))
+            );
+            const mandelbrot_6d::PowMode start_mode = mandelbrot_6d::choose_pow_mode(path.transforms[transform_index], path.translate);
+            const mandelbrot_6d::PowMode end_mode = mandelbrot_6d::choose_pow_mode(path.transforms[next_index], path.translate);
+            const auto pow_mode = static_cast<uint>(start_mode == end_mode ? start_mode : mandelbrot_6d::PowMode::kComplex);
+            stream << blur_shader(
+                slot.image, rotor_path, path_settings.scale, path.translate, kMaxIterations, kPeriodTolerance, pow_mode,
+                kBlurSamples
+            ).dispatch(kImageWidth, kImageHeight);
+        } else {
+            const float6x6& transform = path.transforms[transform_index];
+            const auto pow_mode = static_cast<uint>(mandelbrot_6d::choose_pow_mode(transform, path.translate));
+            stream << main_shader(slot.image, transform, path.translate, kMaxIterations, kPeriodTolerance, pow_mode)
+                .dispatch(kImageWidth, kImageHeight);
         }
+        if (video_mode) {
+            stream
+                << yuv_shader(slot.image, slot.yuv).dispatch(kImageWidth / 8, kImageHeight / 2)
+                << slot.yuv.copy_to(slot.pixels.data());
+        } else {
+            slot.pixels = encoder->take_buffer(kFrameBytes);
+            stream << slot.image.copy_to(slot.pixels.data());
+        }
+        stream << frame_ready.signal(render_cnt + 1);
 
-        stbi_write_png(
-            (
-                file_save_path / (std::to_string(render_index) + std::string(".png"))
-            ).string().data(),
-            kImageWidth, kImageHeight, 4,
-            pixels.data(), 0
-        );
+        if (render_cnt + 1 >= kRingSize) { stopped = !hand_off(handed_cnt++); }
+    }
+    while (!stopped && handed_cnt < kRenderTimes) { stopped = !hand_off(handed_cnt++); }
+    stream << synchronize();
+    if (encoder) {
+        encoder->wait();
+        if (encoder->failures() != 0) { LUISA_WARNING("{} frame(s) failed to write", encoder->failures()); }
+    }
+    if (stopped) { return 0; }
+
+    if (video_mode) {
+        // 视频流不需要拼接, 写到文件时输出转码的命令
+        if (video_file != "-") {
+            std::cout
+                << "ffmpeg -i \"" << video_file << "\""
+                << " -vcodec libx264 -pix_fmt yuv420p -movflags +faststart"
+                << " \"" << (filesystem::current_path() / "_111.mp4").string() << "\"";
+        }
+        return 0;
     }
 
-    // 输出合成视频的命令
-    std::cout
-        << "ffmpeg -f image2 -i"
-        << " \"" << (file_save_path / "%d.png").string() << "\""
-        << " -vcodec libx264"
-        << " -pix_fmt yuv420p -movflags +faststart -framerate 60"
-        << " \"" << (filesystem::current_path() / "_111.mp4").string() << "\"";
+    print_ffmpeg_command(kImageWidth, kImageHeight);
 }
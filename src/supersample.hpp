@@ -0,0 +1,175 @@
+#pragma once
+
+#include <luisa/luisa-compute.h>
+#include "float6.hpp"
+#include "mandelbrot_6d.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* 自适应超采样抗锯齿: 先每个像素在中心采一次, 记下迭代次数和到集合的距离估计; 然后找出和8个相邻像素的迭代次数相差较大,
+ * 或者一个是内部点一个不是, 或者距离估计不到kEdgeDistance个像素(集合的细丝穿过这个像素, 相邻像素的次数却可能差不多)的像素,
+ * 用原子计数压缩成一个列表; 最后只对列表里的像素做grid x grid个分层抖动采样,
+ * 取平均作为像素值. 大片平滑的区域保持一次采样, 采样数集中在边界和细丝上.
+ * 和分块渲染一样, 最后一个pass按最多可能的像素数dispatch, 超出列表长度的线程直接返回, 不需要读回host
+ */
+namespace supersample {
+constexpr uint kDefaultGrid = 4;      // 边缘像素4 x 4 = 16次采样
+constexpr uint kDefaultThreshold = 2; // 相邻像素迭代次数相差超过它时加采样
+constexpr float kEdgeDistance = 1.F;  // 逃逸的像素离集合不到这么多像素时加采样
+
+namespace detail {
+// PCG的输出置换, 用作无状态的哈希
+[[nodiscard]] inline UInt pcg_hash(const UInt& input) {
+    UInt state = input * 747796405u + 2891336453u;
+    UInt word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// 取高24位换成[0, 1)的float
+[[nodiscard]] inline Float to_unit(const UInt& bits) {
+    return (bits >> 8u).cast<float>() * (1.F / 16777216.F);
+}
+}  // namespace detail
+
+class AdaptiveSupersampler {
+public:
+    AdaptiveSupersampler(
+        Device& device, uint width, uint height, uint grid = kDefaultGrid, uint threshold = kDefaultThreshold
+    )
+        : width_(width), height_(height), grid_(grid), threshold_(threshold),
+          iterations_(device.create_buffer<uint>(static_cast<size_t>(width) * height)),
+          distances_(device.create_buffer<float>(static_cast<size_t>(width) * height)),
+          work_list_(device.create_buffer<uint>(static_cast<size_t>(width) * height)),
+          counter_(device.create_buffer<uint>(1)),
+          sample_shader_(device.compile(sample_kernel())),
+          mark_shader_(device.compile(mark_kernel())),
+          refine_shader_(device.compile(refine_kernel())) {}
+
+    /* 把一帧的全部pass提交到stream上. uniform为true时每个像素都加采样,
+     * 即同样grid的均匀超采样, 用来和自适应的结果比较
+     */
+    void render(
+        Stream& stream, const Image<float>& image, const float6x6& transform, const float6& translate_vec,
+        uint max_iterations, float period_tolerance, bool uniform = false
+    ) {
+        const auto pow_mode = static_cast<uint>(mandelbrot_6d::choose_pow_mode(transform, translate_vec));
+        const float pixel_size = mandelbrot_6d::c_pixel_size(transform, width_, height_);
+        stream
+            << counter_.copy_from(&zero_)
+            << sample_shader_(
+                image, iterations_, distances_, transform, translate_vec, max_iterations, period_tolerance, pow_mode,
+                pixel_size
+            ).dispatch(width_, height_)
+            << mark_shader_(iterations_, distances_, work_list_, counter_, max_iterations, threshold_, uniform)
+                .dispatch(width_, height_)
+            << refine_shader_(
+                image, work_list_, counter_, transform, translate_vec, max_iterations, period_tolerance, pow_mode, grid_
+            ).dispatch(width_ * height_);
+    }
+
+    // 上一帧加采样的像素数, 会同步stream
+    [[nodiscard]] uint refined_count(Stream& stream) const {
+        uint count = 0;
+        stream << counter_.copy_to(&count) << synchronize();
+        return count;
+    }
+
+    [[nodiscard]] uint samples_per_refined_pixel() const { return grid_ * grid_; }
+
+private:
+    /* 第一个pass: 像素中心一次采样, 和逐像素kernel的结果相同.
+     * 另外按DualComplex传播dz/dc, 记下按像素计的距离估计(mandelbrot_6d::distance_estimate)
+     */
+    static Kernel2D<Image<float>, Buffer<uint>, Buffer<float>, float6x6, float6, uint, float, uint, float> sample_kernel() {
+        return [](
+            ImageFloat image, BufferUInt iterations, BufferFloat distances, const Float6x6& transform,
+            const Float6& translate_vec, UInt max_iterations, Float period_tolerance, UInt pow_mode, Float pixel_size
+        ) {
+            set_block_size(16, 16);
+            UInt2 pixel = dispatch_id().xy();
+            UInt pixel_idx = pixel.y * dispatch_size().x + pixel.x;
+            Float2 uv_pos = mandelbrot_6d::pixel_uv(pixel, dispatch_size().xy());
+            Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+            mandelbrot_6d::Orbit orbit = mandelbrot_6d::iterate_orbit(pos, max_iterations, period_tolerance, pow_mode);
+            iterations.write(pixel_idx, orbit.iterations_cnt);
+            distances.write(pixel_idx, mandelbrot_6d::distance_estimate(orbit, max_iterations) / pixel_size);
+            image.write(pixel, mandelbrot_6d::shade(orbit.iterations_cnt, max_iterations, uv_pos));
+        };
+    }
+
+    // 第二个pass: 看距离估计并和相邻的8个像素比较, 需要加采样的像素追加到work_list
+    static Kernel2D<Buffer<uint>, Buffer<float>, Buffer<uint>, Buffer<uint>, uint, uint, bool> mark_kernel() {
+        return [](
+            BufferUInt iterations, BufferFloat distances, BufferUInt work_list, BufferUInt counter, UInt max_iterations,
+            UInt threshold, Bool uniform
+        ) {
+            set_block_size(16, 16);
+            UInt2 pixel = dispatch_id().xy();
+            UInt2 size = dispatch_size().xy();
+            UInt pixel_idx = pixel.y * size.x + pixel.x;
+            Int center = iterations.read(pixel_idx).cast<int>();
+            Bool center_interior = center == max_iterations.cast<int>();
+            Bool refine = uniform || (!center_interior && distances.read(pixel_idx) < kEdgeDistance);
+            for (int offset_y = -1; offset_y <= 1; ++offset_y) {
+                for (int offset_x = -1; offset_x <= 1; ++offset_x) {
+                    if (offset_x == 0 && offset_y == 0) { continue; }
+                    Int2 neighbor = make_int2(pixel) + make_int2(offset_x, offset_y);
+                    Bool inside = neighbor.x >= 0 && neighbor.y >= 0
+                        && neighbor.x < size.x.cast<int>() && neighbor.y < size.y.cast<int>();
+                    if_(inside && !refine, [&] {
+                        UInt2 other_pixel = make_uint2(neighbor);
+                        Int other = iterations.read(other_pixel.y * size.x + other_pixel.x).cast<int>();
+                        Bool other_interior = other == max_iterations.cast<int>();
+                        refine = abs(other - center) > threshold.cast<int>() || other_interior != center_interior;
+                    });
+                }
+            }
+            if_(refine, [&] {
+                work_list.write(counter.atomic(0u).fetch_add(1u), pixel_idx);
+            });
+        };
+    }
+
+    // 第三个pass: 每个线程给列表里的一个像素做grid x grid个分层采样, 每个子格里的位置按哈希抖动
+    static Kernel1D<Image<float>, Buffer<uint>, Buffer<uint>, float6x6, float6, uint, float, uint, uint> refine_kernel() {
+        return [](
+            ImageFloat image, BufferUInt work_list, BufferUInt counter, const Float6x6& transform,
+            const Float6& translate_vec, UInt max_iterations, Float period_tolerance, UInt pow_mode, UInt grid
+        ) {
+            set_block_size(64);
+            UInt work_idx = dispatch_id().x;
+            if_(work_idx >= counter.read(0u), [] { return_(); });
+
+            UInt2 size = image.size();
+            UInt pixel_idx = work_list.read(work_idx);
+            UInt2 pixel = make_uint2(pixel_idx % size.x, pixel_idx / size.x);
+            UInt samples = grid * grid;
+            Float4 color_sum = make_float4(0.F);
+            for (auto sample_idx: dynamic_range(samples)) {
+                UInt hash = detail::pcg_hash(pixel_idx * samples + sample_idx);
+                Float2 jitter = make_float2(detail::to_unit(hash), detail::to_unit(detail::pcg_hash(hash)));
+                Float2 cell = make_float2(make_uint2(sample_idx % grid, sample_idx / grid));
+                Float2 uv_pos = (make_float2(pixel) + (cell + jitter) / grid.cast<float>()) / make_float2(size);
+                Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+                UInt iterations_cnt = mandelbrot_6d::iterate(pos, max_iterations, period_tolerance, pow_mode);
+                color_sum += mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos);
+            };
+            image.write(pixel, color_sum / samples.cast<float>());
+        };
+    }
+
+    uint width_;
+    uint height_;
+    uint grid_;
+    uint threshold_;
+    uint zero_ = 0;
+    Buffer<uint> iterations_;  // 第一个pass每个像素的迭代次数
+    Buffer<float> distances_;  // 第一个pass每个像素到集合的距离估计, 按像素计, 内部点为0
+    Buffer<uint> work_list_;   // 需要加采样的像素下标
+    Buffer<uint> counter_;     // work_list的长度
+    Shader2D<Image<float>, Buffer<uint>, Buffer<float>, float6x6, float6, uint, float, uint, float> sample_shader_;
+    Shader2D<Buffer<uint>, Buffer<float>, Buffer<uint>, Buffer<uint>, uint, uint, bool> mark_shader_;
+    Shader1D<Image<float>, Buffer<uint>, Buffer<uint>, float6x6, float6, uint, float, uint, uint> refine_shader_;
+};
+}  // namespace supersample
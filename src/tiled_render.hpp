@@ -0,0 +1,242 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <luisa/luisa-compute.h>
+#include "float6.hpp"
+#include "mandelbrot_6d.hpp"
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* Mariani-Silver分块渲染: 先只算块的边界, 边界上迭代次数全部相同的块直接整块填充, 否则分成4块继续,
+ * 到最小的块还不一致时逐像素计算内部. 大片内部点或者同一迭代次数的区域只需要算边界.
+ * 整个过程在设备上: 每一层有自己的块队列, 细分出的子块用原子计数追加到下一层,
+ * 各层的dispatch按这一层最多可能的块数发出, 超出实际块数的线程直接返回, 所以不需要把块数读回host.
+ *
+ * 只看边界时, 块里面孤立的结构(小的内部点区域)会被填平. 所以逃逸的块还要检查边界上的距离估计
+ * (mandelbrot_6d::distance_estimate, 按像素计): 真实距离不小于估计值的一半, 估计值都不小于块的边长时
+ * 块里没有集合的点, 这时迭代次数的等值区域不会在块里面闭合, 整块填充和逐像素计算一致.
+ * 这个论证要求画面里只有c在变(z_0和X整帧不变); 一般的六维切片上距离估计只是c方向的, 全是内部点的块也仍然只看边界,
+ * 这两种情况下仍可能和逐像素渲染不同. 吞吐量测试(bench)会数出不同的像素
+ */
+namespace tiled_render {
+constexpr uint kTileSize = 64;      // 第一层的块边长, 图像的宽高需要是它的倍数
+constexpr uint kLevels = 4;         // 64, 32, 16, 8
+constexpr uint kUnknown = ~0u;      // 迭代次数缓冲区里还没算过的像素
+constexpr uint kSplit = ~0u;        // 块状态: 边界不一致或者离集合太近, 需要细分(或者在最后一层逐像素计算)
+
+class TiledRenderer {
+public:
+    TiledRenderer(Device& device, Stream& stream, uint width, uint height)
+        : width_(width), height_(height),
+          iterations_(device.create_buffer<uint>(static_cast<size_t>(width) * height)),
+          distances_(device.create_buffer<float>(static_cast<size_t>(width) * height)),
+          counters_(device.create_buffer<uint>(kLevels)),
+          no_next_tiles_(device.create_buffer<uint2>(1)),
+          clear_shader_(device.compile(clear_kernel())),
+          border_shader_(device.compile(border_kernel())),
+          classify_shader_(device.compile(classify_kernel())),
+          fill_shader_(device.compile(fill_kernel())) {
+        if (width % kTileSize != 0 || height % kTileSize != 0) {
+            LUISA_ERROR_WITH_LOCATION("Image size {}x{} is not a multiple of the tile size {}.", width, height, kTileSize);
+        }
+        for (uint level = 0; level < kLevels; ++level) {
+            tiles_.push_back(device.create_buffer<uint2>(capacity(level)));
+            states_.push_back(device.create_buffer<uint>(capacity(level)));
+        }
+        // 第一层的块是固定的, 每帧只需要重置计数
+        std::vector<uint2> first_tiles;
+        first_tiles.reserve(capacity(0));
+        for (uint tile_y = 0; tile_y < height; tile_y += kTileSize) {
+            for (uint tile_x = 0; tile_x < width; tile_x += kTileSize) { first_tiles.push_back(make_uint2(tile_x, tile_y)); }
+        }
+        initial_counts_[0] = capacity(0);
+        stream << tiles_[0].copy_from(first_tiles.data()) << synchronize();
+    }
+
+    // 把一帧的全部pass提交到stream上, 结果和逐像素kernel写同样的像素值(限制见文件开头)
+    void render(
+        Stream& stream, const Image<float>& image, const float6x6& transform, const float6& translate_vec,
+        uint max_iterations, float period_tolerance
+    ) {
+        const auto pow_mode = static_cast<uint>(mandelbrot_6d::choose_pow_mode(transform, translate_vec));
+        const float pixel_size = mandelbrot_6d::c_pixel_size(transform, width_, height_);
+        stream
+            << counters_.copy_from(initial_counts_.data())
+            << clear_shader_(iterations_).dispatch(width_, height_);
+        for (uint level = 0; level < kLevels; ++level) {
+            const uint tile_size = kTileSize >> level;
+            const bool is_last = level + 1 == kLevels;
+            // 最后一层不会追加子块, 绑一个单独的占位缓冲区, 不让同一个缓冲区既是输入又是输出
+            const Buffer<uint2>& next_tiles = is_last ? no_next_tiles_ : tiles_[level + 1];
+            stream
+                << border_shader_(
+                    image, iterations_, distances_, tiles_[level], counters_, level, tile_size,
+                    transform, translate_vec, max_iterations, period_tolerance, pow_mode, pixel_size
+                ).dispatch(4 * (tile_size - 1), capacity(level))
+                << classify_shader_(
+                    iterations_, distances_, tiles_[level], states_[level], next_tiles, counters_, level, tile_size, width_,
+                    max_iterations, is_last
+                ).dispatch(capacity(level))
+                << fill_shader_(
+                    image, tiles_[level], states_[level], counters_, level, tile_size, is_last,
+                    transform, translate_vec, max_iterations, period_tolerance, pow_mode
+                ).dispatch(tile_size * tile_size, capacity(level));
+        }
+    }
+
+private:
+    // 第level层最多的块数: 整张图都切成这一层的大小
+    [[nodiscard]] uint capacity(uint level) const {
+        const uint tile_size = kTileSize >> level;
+        return (width_ / tile_size) * (height_ / tile_size);
+    }
+
+    static Kernel2D<Buffer<uint>> clear_kernel() {
+        return [](BufferUInt iterations) {
+            iterations.write(dispatch_id().y * dispatch_size().x + dispatch_id().x, kUnknown);
+        };
+    }
+
+    /* 每个线程算一个块的一个边界像素, 顺时针从左上角开始; 和父块共用的边界已经算过, 跳过.
+     * 边界像素另外记下按像素计的距离估计, 迭代次数和只数次数的iterate相同
+     */
+    static Kernel2D<
+        Image<float>, Buffer<uint>, Buffer<float>, Buffer<uint2>, Buffer<uint>, uint, uint, float6x6, float6, uint, float, uint,
+        float
+    >
+    border_kernel() {
+        return [](
+            ImageFloat image, BufferUInt iterations, BufferFloat distances, BufferUInt2 tiles, BufferUInt counters,
+            UInt level, UInt tile_size, const Float6x6& transform, const Float6& translate_vec, UInt max_iterations,
+            Float period_tolerance, UInt pow_mode, Float pixel_size
+        ) {
+            UInt tile_idx = dispatch_id().y;
+            if_(tile_idx >= counters.read(level), [] { return_(); });
+
+            UInt side_len = tile_size - 1u;
+            UInt side = dispatch_id().x / side_len;
+            UInt offset = dispatch_id().x % side_len;
+            UInt2 local = make_uint2(offset, 0u);
+            if_(side == 1u, [&] {
+                local = make_uint2(side_len, offset);
+            }).elif_(side == 2u, [&] {
+                local = make_uint2(side_len - offset, side_len);
+            }).elif_(side == 3u, [&] {
+                local = make_uint2(0u, side_len - offset);
+            });
+            UInt2 pixel = tiles.read(tile_idx) + local;
+            UInt pixel_idx = pixel.y * image.size().x + pixel.x;
+            if_(iterations.read(pixel_idx) == kUnknown, [&] {
+                Float2 uv_pos = mandelbrot_6d::pixel_uv(pixel, image.size());
+                Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+                mandelbrot_6d::Orbit orbit = mandelbrot_6d::iterate_orbit(pos, max_iterations, period_tolerance, pow_mode);
+                iterations.write(pixel_idx, orbit.iterations_cnt);
+                distances.write(pixel_idx, mandelbrot_6d::distance_estimate(orbit, max_iterations) / pixel_size);
+                image.write(pixel, mandelbrot_6d::shade(orbit.iterations_cnt, max_iterations, uv_pos));
+            });
+        };
+    }
+
+    /* 每个线程检查一个块的边界, 一致并且(逃逸的块)离集合足够远时记下迭代次数,
+     * 否则(不是最后一层时)把4个子块追加到下一层
+     */
+    static Kernel1D<
+        Buffer<uint>, Buffer<float>, Buffer<uint2>, Buffer<uint>, Buffer<uint2>, Buffer<uint>, uint, uint, uint, uint, bool
+    >
+    classify_kernel() {
+        return [](
+            BufferUInt iterations, BufferFloat distances, BufferUInt2 tiles, BufferUInt states, BufferUInt2 next_tiles,
+            BufferUInt counters, UInt level, UInt tile_size, UInt width, UInt max_iterations, Bool is_last
+        ) {
+            set_block_size(64);
+            UInt tile_idx = dispatch_id().x;
+            if_(tile_idx >= counters.read(level), [] { return_(); });
+
+            UInt2 origin = tiles.read(tile_idx);
+            UInt side_len = tile_size - 1u;
+            UInt first = iterations.read(origin.y * width + origin.x);
+            // 块内的点离最近的边界像素不超过半个边长, 距离估计(真实距离的2倍以内)至少是整个边长才能说明块里没有集合的点
+            Float min_distance = tile_size.cast<float>();
+            Bool uniform = true;
+            // 四条边同时走, 遇到不一致或者离集合太近的就停
+            for (auto offset: dynamic_range(side_len)) {
+                const std::array<UInt2, 4> locals{
+                    make_uint2(offset, 0u), make_uint2(side_len, offset),
+                    make_uint2(side_len - offset, side_len), make_uint2(0u, side_len - offset)
+                };
+                for (const UInt2& local : locals) {
+                    UInt2 pixel = origin + local;
+                    UInt pixel_idx = pixel.y * width + pixel.x;
+                    if_(iterations.read(pixel_idx) != first, [&] { uniform = false; });
+                    if_(first != max_iterations && distances.read(pixel_idx) < min_distance, [&] { uniform = false; });
+                }
+                if_(!uniform, break_);
+            };
+
+            if_(uniform, [&] {
+                states.write(tile_idx, first);
+            }).else_([&] {
+                states.write(tile_idx, kSplit);
+                if_(!is_last, [&] {
+                    UInt half = tile_size / 2u;
+                    UInt slot = counters.atomic(level + 1u).fetch_add(4u);
+                    next_tiles.write(slot, origin);
+                    next_tiles.write(slot + 1u, origin + make_uint2(half, 0u));
+                    next_tiles.write(slot + 2u, origin + make_uint2(0u, half));
+                    next_tiles.write(slot + 3u, origin + make_uint2(half, half));
+                });
+            });
+        };
+    }
+
+    // 每个线程负责一个块内部(不含边界)的一个像素: 一致的块直接填, 最后一层不一致的块逐像素计算
+    static Kernel2D<Image<float>, Buffer<uint2>, Buffer<uint>, Buffer<uint>, uint, uint, bool, float6x6, float6, uint, float, uint>
+    fill_kernel() {
+        return [](
+            ImageFloat image, BufferUInt2 tiles, BufferUInt states, BufferUInt counters, UInt level, UInt tile_size,
+            Bool is_last, const Float6x6& transform, const Float6& translate_vec, UInt max_iterations, Float period_tolerance,
+            UInt pow_mode
+        ) {
+            UInt tile_idx = dispatch_id().y;
+            if_(tile_idx >= counters.read(level), [] { return_(); });
+
+            UInt2 local = make_uint2(dispatch_id().x % tile_size, dispatch_id().x / tile_size);
+            UInt side_len = tile_size - 1u;
+            if_(local.x == 0u || local.y == 0u || local.x == side_len || local.y == side_len, [] { return_(); });
+
+            UInt2 pixel = tiles.read(tile_idx) + local;
+            UInt state = states.read(tile_idx);
+            Float2 uv_pos = mandelbrot_6d::pixel_uv(pixel, image.size());
+            if_(state != kSplit, [&] {
+                image.write(pixel, mandelbrot_6d::shade(state, max_iterations, uv_pos));
+            }).elif_(is_last, [&] {
+                Float6 pos = mandelbrot_6d::sample_position(uv_pos, transform, translate_vec);
+                UInt iterations_cnt = mandelbrot_6d::iterate(pos, max_iterations, period_tolerance, pow_mode);
+                image.write(pixel, mandelbrot_6d::shade(iterations_cnt, max_iterations, uv_pos));
+            });
+        };
+    }
+
+    uint width_;
+    uint height_;
+    Buffer<uint> iterations_;                  // 每个像素的迭代次数, 只有边界像素会写
+    Buffer<float> distances_;                  // 边界像素到集合的距离估计, 按像素计
+    Buffer<uint> counters_;                    // 每一层的块数
+    Buffer<uint2> no_next_tiles_;              // 最后一层classify的next_tiles参数, 不会被写
+    std::vector<Buffer<uint2>> tiles_;         // 每一层的块(左上角坐标)
+    std::vector<Buffer<uint>> states_;         // 每一层的块状态: 一致的迭代次数或者kSplit
+    std::array<uint, kLevels> initial_counts_{};
+    Shader2D<Buffer<uint>> clear_shader_;
+    Shader2D<
+        Image<float>, Buffer<uint>, Buffer<float>, Buffer<uint2>, Buffer<uint>, uint, uint, float6x6, float6, uint, float, uint,
+        float
+    > border_shader_;
+    Shader1D<
+        Buffer<uint>, Buffer<float>, Buffer<uint2>, Buffer<uint>, Buffer<uint2>, Buffer<uint>, uint, uint, uint, uint, bool
+    > classify_shader_;
+    Shader2D<Image<float>, Buffer<uint2>, Buffer<uint>, Buffer<uint>, uint, uint, bool, float6x6, float6, uint, float, uint> fill_shader_;
+};
+}  // namespace tiled_render
@@ -0,0 +1,838 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "float6.hpp"
+#include "ga.hpp"
+#include "ga_expr.hpp"
+#include "ga_graded.hpp"
+
+namespace vga6 {
+    // 六维VGA
+    using ga_type = GeoAlg<double, 6, {-1, -1, -1, -1, -1, -1}>;
+    // 单精度版本, 一个寄存器能放8(AVX2)或16(AVX-512)个系数
+    using ga_type_f = GeoAlg<float, 6, {-1.F, -1.F, -1.F, -1.F, -1.F, -1.F}>;
+
+    using vector_type = GradedGeoAlg<ga_type, 0b0000010>;      // 1-向量, 6个系数
+    using bivector_type = GradedGeoAlg<ga_type, 0b0000100>;    // 2-向量, 15个系数
+    using quadvector_type = GradedGeoAlg<ga_type, 0b0010000>;  // 4-向量, 15个系数
+    using pseudoscalar_type = GradedGeoAlg<ga_type, 0b1000000>;
+    using rotor_type = GradedGeoAlg<ga_type, ga_graded::even_grades<6>()>; // 偶子代数, 32个系数
+
+    [[nodiscard]] inline float6 to_float6(ga_type val) {
+        return make_float6(
+            val.data[0b000001],
+            val.data[0b000010],
+            val.data[0b000100],
+            val.data[0b001000],
+            val.data[0b010000],
+            val.data[0b100000]
+        );
+    }
+
+    [[nodiscard]] inline float6 to_float6(const vector_type& val) {
+        return make_float6(
+            val.coeff(0b000001),
+            val.coeff(0b000010),
+            val.coeff(0b000100),
+            val.coeff(0b001000),
+            val.coeff(0b010000),
+            val.coeff(0b100000)
+        );
+    }
+
+    inline ga_type make_ga_point(std::array<double, 6> pos) {
+        ga_type result;
+        result.data[0b000001] = pos[0];
+        result.data[0b000010] = pos[1];
+        result.data[0b000100] = pos[2];
+        result.data[0b001000] = pos[3];
+        result.data[0b010000] = pos[4];
+        result.data[0b100000] = pos[5];
+        return result;
+    }
+
+    // 6x6矩阵, [列][行]
+    using matrix6 = std::array<std::array<double, 6>, 6>;
+
+    namespace detail {
+        /* R e_i ~R 的第j个分量中来自R的基a的那一项
+         * 结果基为e_j时, 右边的基b = a ^ e_i ^ e_j, 符号在编译期确定: sign(a, e_i) * sign(a ^ e_i, b) * reverse(b)
+         * R是偶数阶的, 奇数阶的a直接消失
+         */
+        template <size_t Col, size_t Row, size_t IdxA>
+        [[nodiscard]] inline double rotor_matrix_term(const ga_type& rotor) {
+            if constexpr (std::popcount(IdxA) % 2 == 1) {
+                return 0.;
+            } else {
+                constexpr size_t kVecI = size_t(1) << Col;
+                constexpr size_t kIdxB = IdxA ^ kVecI ^ (size_t(1) << Row);
+                constexpr double kReverse = (std::popcount(kIdxB) % 4 == 0 || std::popcount(kIdxB) % 4 == 1) ? 1. : -1.;
+                constexpr double kSign = ga_type::blade_sign(IdxA, kVecI) * ga_type::blade_sign(IdxA ^ kVecI, kIdxB) * kReverse;
+                return kSign * rotor.data[IdxA] * rotor.data[kIdxB];
+            }
+        }
+
+        template <size_t Col, size_t Row, size_t... IdxA>
+        [[nodiscard]] inline double rotor_matrix_entry(const ga_type& rotor, std::index_sequence<IdxA...> /*unused*/) {
+            return (0. + ... + rotor_matrix_term<Col, Row, IdxA>(rotor));
+        }
+
+        // 矩阵的第Col列, 即R e_Col ~R
+        template <size_t Col, size_t... Row>
+        [[nodiscard]] inline std::array<double, 6> rotor_matrix_column(
+            const ga_type& rotor, std::index_sequence<Row...> /*unused*/
+        ) {
+            return {rotor_matrix_entry<Col, Row>(rotor, std::make_index_sequence<ga_type::kBasesCnt>{})...};
+        }
+
+        template <size_t... Col>
+        [[nodiscard]] inline matrix6 rotor_matrix(const ga_type& rotor, std::index_sequence<Col...> /*unused*/) {
+            return {rotor_matrix_column<Col>(rotor, std::make_index_sequence<6>{})...};
+        }
+
+        [[nodiscard]] inline float6 to_float6(const std::array<double, 6>& column, double scale) {
+            return make_float6(
+                column[0] * scale, column[1] * scale, column[2] * scale,
+                column[3] * scale, column[4] * scale, column[5] * scale
+            );
+        }
+    }  // namespace detail
+
+    /* 旋量对应的6x6旋转矩阵, 第i列是R e_i ~R
+     * 每个元素是R的系数的二次型: M_{ji} = sum_a sign * R_a * R_{a ^ e_i ^ e_j}, 符号在编译期算好
+     * 一共36 * 32项乘加, 不需要做任何完整的几何积
+     */
+    [[nodiscard]] inline matrix6 rotor_matrix_columns(const ga_type& rotor) {
+        return detail::rotor_matrix(rotor, std::make_index_sequence<6>{});
+    }
+
+    // 同上, 转成float6x6并乘以scale
+    [[nodiscard]] inline float6x6 rotor_to_matrix(const ga_type& rotor, double scale = 1.) {
+        const matrix6 columns = rotor_matrix_columns(rotor);
+        return float6x6{
+            .col1 = detail::to_float6(columns[0], scale),
+            .col2 = detail::to_float6(columns[1], scale),
+            .col3 = detail::to_float6(columns[2], scale),
+            .col4 = detail::to_float6(columns[3], scale),
+            .col5 = detail::to_float6(columns[4], scale),
+            .col6 = detail::to_float6(columns[5], scale)
+        };
+    }
+
+    // 批量转换, 比如动画的所有关键帧
+    [[nodiscard]] inline std::vector<float6x6> rotor_to_matrix(std::span<const ga_type> rotors, double scale = 1.) {
+        std::vector<float6x6> result;
+        result.reserve(rotors.size());
+        for (const ga_type& rotor : rotors) {
+            result.push_back(rotor_to_matrix(rotor, scale));
+        }
+        return result;
+    }
+
+    /* 二重向量的不变量分解: B = b_1 + b_2 + b_3, b_i是互相正交(因此互相交换)的简单二重向量
+     * λ_i = b_i^2是标量. 平方相同(相对差小于tolerance)的分量无法稳定地拆开(比如等斜旋转), 这时把它们的和作为一组
+     */
+    struct BivectorSplit {
+        size_t count = 0;                       // 组数, 平方为0的组不算
+        std::array<bivector_type, 3> parts{};   // 每组分量的和
+        std::array<double, 3> squares{};        // 组内分量的平方λ的平均值
+        std::array<size_t, 3> multiplicity{};   // 组内分量的个数
+    };
+
+    constexpr double kSameSquareTolerance = 1e-6; // split_bivector: 组内的平面按等角处理, 只合并几乎相等的λ
+    /* bivector_exp: λ之差(相对最大的|λ|)小于它的分量不用投影拆开, 在平均值处展开到二阶.
+     * 拆开的误差约为eps / gap^2, 展开的误差约为gap^3, 两者在gap ≈ eps^(1/5)附近相当, 实测1e-3时最大误差约1e-9
+     */
+    constexpr double kSplitGap = 1e-3;
+    /* rotor_log: 三个cos 2θ之差都小于它时不再拆出单独的平面, 对整个旋转矩阵在平均值处展开到二阶.
+     * 拆开的误差约为eps / gap, 展开的误差约为gap^3, 两者在gap ≈ eps^(1/4)附近相当
+     */
+    constexpr double kLogSplitGap = 1e-4;
+
+    namespace detail {
+        // x^3 - e1 x^2 + e2 x - e3 = 0 的三个实根(从小到大), 根是λ_i, 系数是它们的初等对称多项式
+        [[nodiscard]] inline std::array<double, 3> solve_invariant_cubic(double e1, double e2, double e3) {
+            // 换元x = t + e1/3 得到 t^3 + p t + q = 0
+            const double shift = e1 / 3.;
+            const double p = e2 - e1 * e1 / 3.;
+            const double q = -2. * e1 * e1 * e1 / 27. + e1 * e2 / 3. - e3;
+
+            std::array<double, 3> roots{shift, shift, shift};
+            if (p < 0.) {
+                const double radius = 2. * std::sqrt(-p / 3.);
+                const double cos_arg = std::clamp(3. * q / (p * radius), -1., 1.);
+                const double phi = std::acos(cos_arg) / 3.;
+                for (size_t k = 0; k < 3; ++k) {
+                    roots[k] = shift + radius * std::cos(phi - 2. * std::numbers::pi * static_cast<double>(k) / 3.);
+                }
+            }
+
+            std::sort(roots.begin(), roots.end());
+            return roots;
+        }
+
+        [[nodiscard]] inline matrix6 matrix_product(const matrix6& lhs, const matrix6& rhs) {
+            matrix6 result{};
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t mid = 0; mid < 6; ++mid) {
+                    for (size_t row = 0; row < 6; ++row) { result[col][row] += lhs[mid][row] * rhs[col][mid]; }
+                }
+            }
+            return result;
+        }
+
+        // (matrix - shift I) / scale
+        [[nodiscard]] inline matrix6 shifted_matrix(const matrix6& matrix, double shift, double scale = 1.) {
+            matrix6 result{};
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t row = 0; row < 6; ++row) {
+                    result[col][row] = ((row == col ? -shift : 0.) + matrix[col][row]) / scale;
+                }
+            }
+            return result;
+        }
+
+        // 二重向量作用在向量上的反对称矩阵, 第i列是<e_i B>_1
+        [[nodiscard]] inline matrix6 bivector_matrix(const bivector_type& bivector) {
+            const ga_type full = bivector.to_full();
+            matrix6 result{};
+            for (size_t low = 0; low < 6; ++low) {
+                for (size_t high = low + 1; high < 6; ++high) {
+                    const double coeff = full.data[(size_t(1) << low) | (size_t(1) << high)];
+                    result[low][high] = -coeff;
+                    result[high][low] = coeff;
+                }
+            }
+            return result;
+        }
+
+        // bivector_matrix的逆, 只取矩阵的反对称部分
+        [[nodiscard]] inline bivector_type matrix_bivector(const matrix6& matrix) {
+            ga_type full;
+            for (size_t low = 0; low < 6; ++low) {
+                for (size_t high = low + 1; high < 6; ++high) {
+                    full.data[(size_t(1) << low) | (size_t(1) << high)] = 0.5 * (matrix[high][low] - matrix[low][high]);
+                }
+            }
+            return bivector_type{full};
+        }
+
+        /* 特征值都是二重的对称矩阵(二重向量的矩阵的平方, 旋转矩阵的对称部分)的三个特征值, 从小到大
+         * 先减去平均值再取迹: 三次方程的系数是sum y^2, sum y^3, y是特征值和平均值之差, 特征值接近时不会相消,
+         * 根的误差约为eps乘矩阵的大小. 直接用特征值本身的初等对称多项式时, 三个根接近的情况下误差会放大到eps^(1/3)
+         */
+        [[nodiscard]] inline std::array<double, 3> paired_eigenvalues(const matrix6& symmetric) {
+            double mean = 0.;
+            for (size_t idx = 0; idx < 6; ++idx) { mean += symmetric[idx][idx] / 6.; }
+            const matrix6 centered = shifted_matrix(symmetric, mean);
+            const matrix6 squared = matrix_product(centered, centered);
+            double power_2 = 0.;
+            double power_3 = 0.;
+            for (size_t col = 0; col < 6; ++col) {
+                power_2 += 0.5 * squared[col][col];
+                for (size_t row = 0; row < 6; ++row) { power_3 += 0.5 * squared[col][row] * centered[row][col]; }
+            }
+            std::array<double, 3> result = solve_invariant_cubic(0., -0.5 * power_2, power_3 / 3.);
+            for (double& root: result) { root += mean; }
+            return result;
+        }
+
+        // W_2 = <B^2>_4 / 2, W_3 = <W_2 B>_6 / 3, λ_i从小到大, e1, e2是它们的初等对称多项式
+        struct BivectorInvariants {
+            double e1 = 0.;
+            double e2 = 0.;
+            quadvector_type wedge_2;
+            pseudoscalar_type wedge_3;
+            std::array<double, 3> roots{};
+        };
+
+        // λ_i是B的矩阵的平方的特征值
+        [[nodiscard]] inline BivectorInvariants bivector_invariants(const bivector_type& bivector) {
+            BivectorInvariants result;
+            const matrix6 matrix = bivector_matrix(bivector);
+            result.roots = paired_eigenvalues(matrix_product(matrix, matrix));
+            const std::array<double, 3>& roots = result.roots;
+            result.e1 = roots[0] + roots[1] + roots[2];
+            result.e2 = roots[0] * roots[1] + roots[0] * roots[2] + roots[1] * roots[2];
+            result.wedge_2 = bivector.multiply<0b0010000>(bivector) * 0.5;
+            result.wedge_3 = result.wedge_2.multiply<0b1000000>(bivector) * (1. / 3.);
+            return result;
+        }
+
+        // Λ_1 = sum λ_i b_i = e1 B - <W_2 B>_2, Λ_2 = sum λ_i^2 b_i = (sum λ_i^2) B - <W_2 Λ_1>_2
+        [[nodiscard]] inline std::array<bivector_type, 2> weighted_bivectors(
+            const bivector_type& bivector, const BivectorInvariants& invariants
+        ) {
+            const bivector_type lambda_1 = bivector * invariants.e1 - invariants.wedge_2.multiply<0b0000100>(bivector);
+            const bivector_type lambda_2 = bivector * (invariants.e1 * invariants.e1 - 2. * invariants.e2)
+                - invariants.wedge_2.multiply<0b0000100>(lambda_1);
+            return {lambda_1, lambda_2};
+        }
+
+        /* 平方为roots[k]的分量b_k = (Λ_2 - (λ_i + λ_j) Λ_1 + λ_i λ_j B) / ((λ_k - λ_i)(λ_k - λ_j))
+         * 只用到另外两个λ的和与积, 它们相等(等斜)时也成立
+         */
+        [[nodiscard]] inline bivector_type single_part(
+            const bivector_type& bivector, const std::array<bivector_type, 2>& weighted, const std::array<double, 3>& roots,
+            size_t k
+        ) {
+            const double root = roots[k];
+            const double others_sum = roots[(k + 1) % 3] + roots[(k + 2) % 3];
+            const double others_product = roots[(k + 1) % 3] * roots[(k + 2) % 3];
+            return (weighted[1] - weighted[0] * others_sum + bivector * others_product)
+                * (1. / (root * root - root * others_sum + others_product));
+        }
+
+        /* 一组互相交换, 平方都是λ的简单二重向量之和S的指数
+         * exp(S) = prod (c + k b_i) = sum_j c^{m-j} k^j W_j, 其中W_j = <S^j>_{2j} / j!
+         * λ < 0时c = cos θ, k = sin θ / θ; λ > 0时换成双曲函数
+         */
+        [[nodiscard]] inline rotor_type cluster_exp(const bivector_type& part, double square, size_t multiplicity) {
+            const double theta = std::sqrt(std::abs(square));
+            double cos_part = 1.;
+            double sinc_part = 1.;
+            if (theta > 1e-12) {
+                if (square < 0.) {
+                    cos_part = std::cos(theta);
+                    sinc_part = std::sin(theta) / theta;
+                } else {
+                    cos_part = std::cosh(theta);
+                    sinc_part = std::sinh(theta) / theta;
+                }
+            }
+
+            rotor_type result;
+            result.data[0] = std::pow(cos_part, static_cast<double>(multiplicity));
+            result = result + rotor_type{part * (std::pow(cos_part, static_cast<double>(multiplicity - 1)) * sinc_part)};
+            if (multiplicity >= 2) {
+                const quadvector_type wedge_2 = part.multiply<0b0010000>(part) * 0.5;
+                result = result + rotor_type{wedge_2 * (std::pow(cos_part, static_cast<double>(multiplicity - 2)) * sinc_part * sinc_part)};
+                if (multiplicity == 3) {
+                    const pseudoscalar_type wedge_3 = wedge_2.multiply<0b1000000>(part) * (1. / 3.);
+                    result = result + rotor_type{wedge_3 * (sinc_part * sinc_part * sinc_part)};
+                }
+            }
+            return result;
+        }
+    }  // namespace detail
+
+    /* 分解步骤:
+     * 1. λ_i由bivector_invariants得到, 按λ分组, 和前一个根相差很小的归入同一组
+     * 2. 单独成组的分量由detail::single_part得到, 剩下的一组是B减去它们.
+     *    只用到组内λ的对称函数(和, 积); 分母是不同组的λ之差, 不会很小
+     * 总共只有几次很小的分阶乘法, 和B的大小无关
+     */
+    [[nodiscard]] inline BivectorSplit split_bivector(const bivector_type& bivector, double tolerance = kSameSquareTolerance) {
+        const detail::BivectorInvariants invariants = detail::bivector_invariants(bivector);
+        const std::array<double, 3>& roots = invariants.roots;
+
+        const double scale = std::max({std::abs(roots[0]), std::abs(roots[2]), 1e-300});
+        std::array<size_t, 3> first{};  // 每组第一个根的下标
+        std::array<size_t, 3> counts{};
+        size_t groups = 0;
+        for (size_t idx = 0; idx < 3; ++idx) {
+            if (groups > 0 && roots[idx] - roots[idx - 1] < tolerance * scale) {
+                ++counts[groups - 1];
+            } else {
+                first[groups] = idx;
+                counts[groups] = 1;
+                ++groups;
+            }
+        }
+
+        std::array<bivector_type, 3> parts{};
+        if (groups == 1) {
+            parts[0] = bivector;
+        } else {
+            const std::array<bivector_type, 2> weighted = detail::weighted_bivectors(bivector, invariants);
+            bivector_type rest = bivector;
+            size_t cluster = groups;  // 多于一个分量的组, 最多一个
+            for (size_t group = 0; group < groups; ++group) {
+                if (counts[group] > 1) {
+                    cluster = group;
+                    continue;
+                }
+                parts[group] = detail::single_part(bivector, weighted, roots, first[group]);
+                rest = rest - parts[group];
+            }
+            if (cluster != groups) { parts[cluster] = rest; }
+        }
+
+        BivectorSplit result;
+        for (size_t group = 0; group < groups; ++group) {
+            // 用分出来的分量重新算一次平均的λ
+            const double square = parts[group].multiply<0b0000001>(parts[group]).data[0] / static_cast<double>(counts[group]);
+            if (std::abs(square) < 1e-30 * scale) { continue; }  // 平方为0的组(插值出来只剩舍入误差)
+            const size_t slot = result.count++;
+            result.parts[slot] = parts[group];
+            result.multiplicity[slot] = counts[group];
+            result.squares[slot] = square;
+        }
+        return result;
+    }
+
+    namespace detail {
+        // 函数在某一点的值和对λ的一阶, 二阶导数
+        struct ScalarJet {
+            double value = 0.;
+            double first = 0.;
+            double second = 0.;
+        };
+
+        // 1 / (2k + 1)!
+        constexpr std::array<double, 12> kInverseOddFactorials = [] {
+            std::array<double, 12> result{};
+            double factorial = 1.;
+            for (size_t k = 0; k < result.size(); ++k) {
+                if (k > 0) { factorial *= static_cast<double>(2 * k) * static_cast<double>(2 * k + 1); }
+                result[k] = 1. / factorial;
+            }
+            return result;
+        }();
+
+        /* 简单二重向量b的指数 exp(b) = C(λ) + S(λ) b, λ = b^2. λ < 0时C = cos θ, S = sin θ / θ(θ = sqrt(-λ)), λ > 0时是双曲函数.
+         * 两者都是λ的整函数: C' = S / 2, S' = (C - S) / (2λ), S'' = (S / 2 - 3 S') / (2λ).
+         * |λ| < 1时后两式相消严重, 改用S的泰勒多项式逐项求导, 12项的截断误差在1e-20以下
+         */
+        [[nodiscard]] inline std::array<ScalarJet, 2> rotation_jets(double square) {
+            ScalarJet cos_jet;
+            ScalarJet sinc_jet;
+            const double theta = std::sqrt(std::abs(square));
+            if (square < 0.) {
+                cos_jet.value = std::cos(theta);
+                sinc_jet.value = theta > 0. ? std::sin(theta) / theta : 1.;
+            } else {
+                cos_jet.value = std::cosh(theta);
+                sinc_jet.value = theta > 0. ? std::sinh(theta) / theta : 1.;
+            }
+            if (std::abs(square) < 1.) {
+                for (size_t k = kInverseOddFactorials.size() - 1; k >= 1; --k) {
+                    const auto order = static_cast<double>(k);
+                    sinc_jet.first = sinc_jet.first * square + order * kInverseOddFactorials[k];
+                    if (k >= 2) { sinc_jet.second = sinc_jet.second * square + order * (order - 1.) * kInverseOddFactorials[k]; }
+                }
+            } else {
+                sinc_jet.first = (cos_jet.value - sinc_jet.value) / (2. * square);
+                sinc_jet.second = (0.5 * sinc_jet.value - 3. * sinc_jet.first) / (2. * square);
+            }
+            cos_jet.first = 0.5 * sinc_jet.value;
+            cos_jet.second = 0.5 * sinc_jet.first;
+            return {cos_jet, sinc_jet};
+        }
+
+        /* 三个平方接近的分量, λ_i = μ + y_i, sum y_i = 0, P = sum y_i^2. f(λ_i) g(λ_j) g(λ_k)({i, j, k}是0, 1, 2的排列)在μ处展开到二阶,
+         * 用y_j + y_k = -y_i, y_j^2 + y_k^2 = P - y_i^2, y_j y_k = y_i^2 - P / 2消去y_j, y_k, 得到 c_0 + c_1 y_i + c_2 y_i^2
+         */
+        [[nodiscard]] inline std::array<double, 3> triple_taylor(const ScalarJet& own, const ScalarJet& other, double spread) {
+            return {
+                own.value * other.value * other.value
+                    + spread * (0.5 * own.value * other.value * other.second - 0.5 * own.value * other.first * other.first),
+                own.first * other.value * other.value - own.value * other.value * other.first,
+                0.5 * own.second * other.value * other.value - own.first * other.value * other.first
+                    - 0.5 * own.value * other.value * other.second + own.value * other.first * other.first
+            };
+        }
+
+        // 两个平方接近的分量, λ = μ ± δ. f(λ_a) g(λ_b)在μ处展开到二阶: c_0 + c_1 y_a, y_a = ±δ, δ^2的项并进c_0
+        [[nodiscard]] inline std::array<double, 2> pair_taylor(const ScalarJet& own, const ScalarJet& other, double half_gap_square) {
+            return {
+                own.value * other.value
+                    + half_gap_square * (0.5 * own.second * other.value - own.first * other.first + 0.5 * own.value * other.second),
+                own.first * other.value - own.value * other.first
+            };
+        }
+
+        // 简单二重向量的指数 C(λ) + S(λ) b
+        [[nodiscard]] inline rotor_type simple_exp(const bivector_type& part, double square) {
+            const std::array<ScalarJet, 2> jets = rotation_jets(square);
+            rotor_type result{part * jets[1].value};
+            result.data[0] = jets[0].value;
+            return result;
+        }
+
+        /* 三个λ都接近平均值μ. exp(B) = prod (C_i + S_i b_i) 每一阶的系数都在μ处展开到二阶:
+         * <>_2 = sum S_i C_j C_k b_i 用B, Y_1 = sum y_i b_i = Λ_1 - μ B, Y_2 = sum y_i^2 b_i 表示;
+         * <>_4 = sum C_k S_i S_j b_i b_j 同理用W_2, Z_1 = sum y_k b_i b_j, Z_2 = sum y_k^2 b_i b_j表示, 其中
+         * sum λ_k b_i b_j = e1 W_2 - <B Λ_1>_4, sum λ_k^2 b_i b_j = (sum λ^2) W_2 - <B Λ_2>_4.
+         * 正好等斜(y = 0)时就是cluster_exp, 不需要把平面分开
+         */
+        [[nodiscard]] inline rotor_type triple_exp(
+            const bivector_type& bivector, const BivectorInvariants& invariants, const std::array<bivector_type, 2>& weighted
+        ) {
+            const std::array<double, 3>& roots = invariants.roots;
+            const double mean = invariants.e1 / 3.;
+            const double spread = (roots[0] - mean) * (roots[0] - mean) + (roots[1] - mean) * (roots[1] - mean)
+                + (roots[2] - mean) * (roots[2] - mean);
+            const double power_2 = invariants.e1 * invariants.e1 - 2. * invariants.e2;  // sum λ^2
+            const std::array<ScalarJet, 2> jets = rotation_jets(mean);
+
+            const bivector_type offset_1 = weighted[0] - bivector * mean;
+            const bivector_type offset_2 = weighted[1] - weighted[0] * (2. * mean) + bivector * (mean * mean);
+            const quadvector_type quad_1 = invariants.wedge_2 * invariants.e1 - bivector.multiply<0b0010000>(weighted[0]);
+            const quadvector_type quad_2 = invariants.wedge_2 * power_2 - bivector.multiply<0b0010000>(weighted[1]);
+            const quadvector_type quad_offset_1 = quad_1 - invariants.wedge_2 * mean;
+            const quadvector_type quad_offset_2 = quad_2 - quad_1 * (2. * mean) + invariants.wedge_2 * (mean * mean);
+
+            const std::array<double, 3> grade_2 = triple_taylor(jets[1], jets[0], spread);
+            const std::array<double, 3> grade_4 = triple_taylor(jets[0], jets[1], spread);
+            rotor_type result{bivector * grade_2[0] + offset_1 * grade_2[1] + offset_2 * grade_2[2]};
+            result = result + rotor_type{invariants.wedge_2 * grade_4[0] + quad_offset_1 * grade_4[1] + quad_offset_2 * grade_4[2]};
+            result = result + rotor_type{invariants.wedge_3 * triple_taylor(jets[1], jets[1], spread)[0]};
+            result.data[0] = triple_taylor(jets[0], jets[0], spread)[0];
+            return result;
+        }
+
+        /* 两个分量之和S, 平方为mean ± half_gap, weighted = sum λ_i b_i.
+         * 隔得开时用投影拆开, 否则同triple_exp在平均值处展开: exp(S) = C_a C_b + sum S_a C_b b_a + S_a S_b W_2(S)
+         */
+        [[nodiscard]] inline rotor_type pair_exp(
+            const bivector_type& pair, const bivector_type& weighted, double mean, double half_gap, bool separate
+        ) {
+            if (separate) {
+                const bivector_type lower = (weighted - pair * (mean + half_gap)) * (-0.5 / half_gap);
+                return simple_exp(lower, mean - half_gap).multiply<rotor_type::kGradeMask>(simple_exp(pair - lower, mean + half_gap));
+            }
+            const std::array<ScalarJet, 2> jets = rotation_jets(mean);
+            const double half_gap_square = half_gap * half_gap;
+            const std::array<double, 2> grade_2 = pair_taylor(jets[1], jets[0], half_gap_square);
+            rotor_type result{pair * grade_2[0] + (weighted - pair * mean) * grade_2[1]};
+            result = result + rotor_type{pair.multiply<0b0010000>(pair) * (0.5 * pair_taylor(jets[1], jets[1], half_gap_square)[0])};
+            result.data[0] = pair_taylor(jets[0], jets[0], half_gap_square)[0];
+            return result;
+        }
+    }  // namespace detail
+
+    /* 二重向量的指数, 闭式解, 代价固定: 一次不变量分解, 每个分量一组cos/sin(或cosh/sinh).
+     * 和其余两个隔得最开的分量用投影分出来, 剩下两个再看能否分开; 分不开(λ之差小于kSplitGap)的分量在平均值处展开到二阶,
+     * 正好相等(等斜旋转)时是精确的
+     */
+    [[nodiscard]] inline rotor_type bivector_exp(const bivector_type& bivector) {
+        const detail::BivectorInvariants invariants = detail::bivector_invariants(bivector);
+        const std::array<double, 3>& roots = invariants.roots;
+        const std::array<bivector_type, 2> weighted = detail::weighted_bivectors(bivector, invariants);
+
+        const double tolerance = kSplitGap * std::max(std::abs(roots[0]), std::abs(roots[2]));
+        const double low_gap = roots[1] - roots[0];
+        const double high_gap = roots[2] - roots[1];
+        if (std::max(low_gap, high_gap) <= tolerance) { return detail::triple_exp(bivector, invariants, weighted); }
+
+        // 分母(λ_k - λ_i)(λ_k - λ_j)至少是较大的间隔的平方
+        const size_t single = low_gap >= high_gap ? 0 : 2;
+        const bivector_type part = detail::single_part(bivector, weighted, roots, single);
+        const rotor_type rest = detail::pair_exp(
+            bivector - part, weighted[0] - part * roots[single], 0.5 * (roots[1] + roots[2 - single]),
+            0.5 * std::abs(roots[2 - single] - roots[1]), std::min(low_gap, high_gap) > tolerance
+        );
+        return detail::simple_exp(part, roots[single]).multiply<rotor_type::kGradeMask>(rest);
+    }
+
+    namespace detail {
+        // 投影矩阵的像里的两个正交单位向量: Gram-Schmidt, 每次取剩余最长的列, 返回它们张成的单位平面
+        [[nodiscard]] inline bivector_type projector_plane(const matrix6& projector) {
+            std::array<vector_type, 6> columns{};
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t row = 0; row < 6; ++row) { columns[col].data[row] = projector[col][row]; }
+            }
+            std::array<vector_type, 2> axes{};
+            for (vector_type& axis: axes) {
+                size_t longest = 0;
+                for (size_t col = 1; col < 6; ++col) {
+                    if (columns[col].norm() > columns[longest].norm()) { longest = col; }
+                }
+                axis = columns[longest] * (1. / columns[longest].norm());
+                for (vector_type& column: columns) {
+                    column = column - axis * -column.multiply<0b0000001>(axis).data[0];  // 度量是负的, <v a>_0 = -v·a
+                }
+            }
+            return axes[0].multiply<0b0000100>(axes[1]);
+        }
+
+        /* 旋转矩阵M在单位平面plane上的转角θ, 只确定到模π
+         * tr(M P) = 2 cos 2θ, tr(M K^T) = 2 sin 2θ, 其中K是plane的矩阵(bivector_matrix), P = -K^2
+         */
+        [[nodiscard]] inline double plane_angle(const matrix6& rotation, const bivector_type& plane) {
+            const matrix6 skew = bivector_matrix(plane);
+            const matrix6 skew_squared = matrix_product(skew, skew);
+            double cos_trace = 0.;
+            double sin_trace = 0.;
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t row = 0; row < 6; ++row) {
+                    cos_trace -= rotation[col][row] * skew_squared[row][col];
+                    sin_trace += rotation[col][row] * skew[col][row];
+                }
+            }
+            return 0.5 * std::atan2(-sin_trace, cos_trace);
+        }
+
+        /* 旋转矩阵的对数是 A g(S), A = (M - M^T) / 2, S = (M + M^T) / 2, g(c) = φ / sin φ (c = cos φ), 即arccos(c) / sqrt(1 - c^2).
+         * 导数由 (1 - c^2) g' = c g - 1 递推: (1 - c^2) g'' = 3 c g' + g. 只在c >= 0上用, 离奇点c = -1很远.
+         * c接近1时递推的分子相消, 但这时展开的偏移也同样小, 乘起来误差仍是eps; c = 1附近直接用g = 1 + t / 3 + 2 t^2 / 15, t = 1 - c
+         */
+        [[nodiscard]] inline ScalarJet log_angle_jet(double cosine) {
+            ScalarJet result;
+            const double distance = 1. - cosine;
+            if (distance < 1e-8) {
+                result.value = 1. + distance / 3.;
+                result.first = -1. / 3. - 4. * distance / 15.;
+                result.second = 4. / 15.;
+                return result;
+            }
+            const double sine_square = distance * (1. + cosine);
+            const double sine = std::sqrt(sine_square);
+            result.value = std::atan2(sine, cosine) / sine;
+            result.first = (cosine * result.value - 1.) / sine_square;
+            result.second = (3. * cosine * result.first + result.value) / sine_square;
+            return result;
+        }
+
+        /* 三个cos 2θ都接近平均值c(c >= 0)时: g(S) = g(c) + g'(c) (S - c) + g''(c) (S - c)^2 / 2, 不需要分开平面.
+         * 旋量exp(B)的矩阵是exp(-2 K_B), 所以K_B = -A g(S) / 2. 结果的exp和原来的旋量可能差一个符号
+         */
+        [[nodiscard]] inline bivector_type near_isoclinic_log(const matrix6& skew, const matrix6& symmetric, double cosine) {
+            const ScalarJet jet = log_angle_jet(cosine);
+            const matrix6 offset = shifted_matrix(symmetric, cosine);
+            const matrix6 offset_squared = matrix_product(offset, offset);
+            matrix6 series{};
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t row = 0; row < 6; ++row) {
+                    series[col][row] = (row == col ? jet.value : 0.) + jet.first * offset[col][row]
+                        + 0.5 * jet.second * offset_squared[col][row];
+                }
+            }
+            return matrix_bivector(matrix_product(skew, series)) * -0.5;
+        }
+
+        /* 只在4维子空间里转动的旋量. 子空间的伪标量J_4 = plane I(plane是和子空间正交的单位平面)满足J_4^2 = 1, 和rotor交换,
+         * (1 ± J_4) / 2把rotor分成左右两个等斜旋转: rotor (1 ± J_4) = cos φ_± (1 ± J_4) + V_±, |V_±| = sqrt(2) sin φ_±,
+         * φ_±是两个平面转角的和与差. 对数是sum φ_± V_± / (sqrt(2) |V_±|), 对任意两个角度都成立, 不需要区分等斜.
+         * V = 0且φ = π时方向任取: 子空间里的任意单位平面x, 取(x ± <x J_4>_2) / 2
+         */
+        [[nodiscard]] inline bivector_type four_dim_log(
+            const rotor_type& rotor, const bivector_type& plane, const matrix6& projector
+        ) {
+            pseudoscalar_type pseudoscalar;
+            pseudoscalar.data[0] = 1.;
+            const quadvector_type dual = plane.multiply<0b0010000>(pseudoscalar);
+            const rotor_type product = rotor.multiply<rotor_type::kGradeMask>(rotor_type{dual});
+
+            // 舍入误差会带来子空间以外的分量; V接近0时方向全由它决定, 所以先投影回子空间和对应的一半
+            bivector_type result;
+            for (const double sign: {1., -1.}) {
+                const rotor_type half = rotor + product * sign;
+                const bivector_type restricted = matrix_bivector(matrix_product(projector, matrix_product(
+                    bivector_matrix(bivector_type{half}), projector
+                )));
+                const bivector_type direction = (restricted + restricted.multiply<0b0000100>(dual) * sign) * 0.5;
+                const double size = direction.norm();
+                const double angle = std::atan2(size / std::sqrt(2.), half.data[0]);
+                if (size > 0.) {
+                    result = result + direction * (angle / (std::sqrt(2.) * size));
+                } else if (half.data[0] < 0.) {
+                    const bivector_type other = projector_plane(projector);
+                    result = result + (other + other.multiply<0b0000100>(dual) * sign) * (0.5 * std::numbers::pi);
+                }
+            }
+            return result;
+        }
+
+        /* 和small交换的复结构J: 三个互相正交的单位平面之和, 平面是small的特征平面(small在上面为0的平面任取).
+         * exp(π J) = -1, exp(π J / 2) = W_3(J) = ±I, 用来给接近-1或±I的旋量补上半圈或四分之一圈.
+         * 三个λ(按最大的|λ|算相对差)都接近平均值μ时J = f(μ) small + f'(μ) Y_1 + f''(μ) Y_2 / 2, f(λ) = (-λ)^(-1/2);
+         * 否则用投影分出隔得最开的平面u, 剩下的4维部分的自对偶或反自对偶部分(u_i ± u_j) / sqrt(2)放大sqrt(2)倍就是4维上的复结构
+         */
+        [[nodiscard]] inline bivector_type commuting_planes(const bivector_type& small) {
+            const BivectorInvariants invariants = bivector_invariants(small);
+            const std::array<double, 3>& roots = invariants.roots;
+            const double scale = -roots[0];
+            if (!(scale > 0.)) {
+                ga_type full;  // e_01 + e_23 + e_45
+                full.data[0b000011] = 1.;
+                full.data[0b001100] = 1.;
+                full.data[0b110000] = 1.;
+                return bivector_type{full};
+            }
+
+            const double low_gap = roots[1] - roots[0];
+            const double high_gap = roots[2] - roots[1];
+            if (std::max(low_gap, high_gap) <= kSplitGap * scale) {
+                const double mean = invariants.e1 / 3.;
+                const std::array<bivector_type, 2> weighted = weighted_bivectors(small, invariants);
+                const double inverse = 1. / std::sqrt(-mean);
+                const bivector_type offset_1 = weighted[0] - small * mean;
+                const bivector_type offset_2 = weighted[1] - weighted[0] * (2. * mean) + small * (mean * mean);
+                const double inverse_3 = inverse * inverse * inverse;
+                return small * inverse + offset_1 * (0.5 * inverse_3) + offset_2 * (0.375 * inverse_3 * inverse * inverse);
+            }
+
+            const size_t single = low_gap >= high_gap ? 0 : 2;
+            const matrix6 matrix = bivector_matrix(small);
+            const matrix6 squared = matrix_product(matrix, matrix);
+            const matrix6 projector = matrix_product(
+                shifted_matrix(squared, roots[1], roots[single] - roots[1]),
+                shifted_matrix(squared, roots[2 - single], roots[single] - roots[2 - single])
+            );
+            const bivector_type plane = projector_plane(projector);
+            // u^2 = -1, small在u上的分量是-<u small>_0 u
+            const bivector_type rest = small + plane * plane.scalar_product(small);
+
+            pseudoscalar_type pseudoscalar;
+            pseudoscalar.data[0] = 1.;
+            const quadvector_type dual = plane.multiply<0b0010000>(pseudoscalar);
+            const bivector_type dual_rest = rest.multiply<0b0000100>(dual);
+            const bivector_type self_dual = (rest + dual_rest) * 0.5;
+            const bivector_type anti_dual = (rest - dual_rest) * 0.5;
+            const bivector_type& larger = self_dual.norm() >= anti_dual.norm() ? self_dual : anti_dual;
+            if (larger.norm() > 0.) { return plane + larger * (std::sqrt(2.) / larger.norm()); }
+
+            matrix6 complement{};
+            for (size_t col = 0; col < 6; ++col) {
+                for (size_t row = 0; row < 6; ++row) { complement[col][row] = (row == col ? 1. : 0.) - projector[col][row]; }
+            }
+            const bivector_type other = projector_plane(complement);
+            return plane + other + other.multiply<0b0000100>(dual);
+        }
+    }  // namespace detail
+
+    /* 单位旋量的对数, 闭式解, 代价固定
+     * 旋转矩阵M在第i个平面上转2θ_i, 对称部分(M + M^T) / 2的特征值是cos 2θ_i(各两重), 由paired_eigenvalues得到.
+     * cos 2θ和其余两个隔得开的平面: 投影矩阵是对称部分的多项式, 从像里取出平面, 角度从M读出(只确定到模π), 再从R中除掉,
+     * 剩下的4维旋量交给four_dim_log, 它对等斜和半圈都是精确的.
+     * 三个cos 2θ都接近时用near_isoclinic_log按矩阵展开. 平均值c < 0时先乘上I(矩阵变成-M, c变成-c), 展开只在c >= 0上做;
+     * 展开的exp和旋量差一个符号或者一个I时, 补上和它交换的复结构(detail::commuting_planes)转半圈或四分之一圈
+     */
+    [[nodiscard]] inline bivector_type rotor_log(const rotor_type& rotor) {
+        const matrix6 rotation = rotor_matrix_columns(rotor.to_full());
+        matrix6 symmetric{};
+        matrix6 skew{};
+        for (size_t col = 0; col < 6; ++col) {
+            for (size_t row = 0; row < 6; ++row) {
+                symmetric[col][row] = 0.5 * (rotation[col][row] + rotation[row][col]);
+                skew[col][row] = 0.5 * (rotation[col][row] - rotation[row][col]);
+            }
+        }
+        const std::array<double, 3> cosines = detail::paired_eigenvalues(symmetric);
+        const double low_gap = cosines[1] - cosines[0];
+        const double high_gap = cosines[2] - cosines[1];
+
+        if (std::max(low_gap, high_gap) < kLogSplitGap) {
+            // I R = R I的矩阵是-M
+            const double cosine = (cosines[0] + cosines[1] + cosines[2]) / 3.;
+            const double flip = cosine < 0. ? -1. : 1.;
+            pseudoscalar_type pseudoscalar;
+            pseudoscalar.data[0] = 1.;
+            const rotor_type shifted = flip < 0. ? rotor.multiply<rotor_type::kGradeMask>(rotor_type{pseudoscalar}) : rotor;
+            const bivector_type result = detail::near_isoclinic_log(
+                detail::shifted_matrix(skew, 0., flip), detail::shifted_matrix(symmetric, 0., flip), flip * cosine
+            );
+            const double sign = bivector_exp(result).reverse().scalar_product(shifted) >= 0. ? 1. : -1.;
+            if (flip > 0. && sign > 0.) { return result; }
+
+            bivector_type planes = detail::commuting_planes(result);
+            if (flip > 0.) { return result + planes * std::numbers::pi; }  // R = -exp(B), exp(π J) = -1
+            // R = -I (I R) = -sign I exp(B), 需要W_3(J) = -sign I
+            const quadvector_type wedge_2 = planes.multiply<0b0010000>(planes) * 0.5;
+            if (wedge_2.multiply<0b1000000>(planes).data[0] * sign > 0.) { planes = planes * -1.; }
+            return result + planes * (0.5 * std::numbers::pi);
+        }
+
+        // 分母(x_k - x_i)(x_k - x_j)至少是较大的间隔的平方
+        const size_t single = low_gap >= high_gap ? 0 : 2;
+        const matrix6 projector = detail::matrix_product(
+            detail::shifted_matrix(symmetric, cosines[1], cosines[single] - cosines[1]),
+            detail::shifted_matrix(symmetric, cosines[2 - single], cosines[single] - cosines[2 - single])
+        );
+        const bivector_type plane = detail::projector_plane(projector);
+        const double angle = detail::plane_angle(rotation, plane);
+        const rotor_type rest = detail::simple_exp(plane * -angle, -angle * angle).multiply<rotor_type::kGradeMask>(rotor);
+
+        matrix6 complement{};
+        for (size_t col = 0; col < 6; ++col) {
+            for (size_t row = 0; row < 6; ++row) { complement[col][row] = (row == col ? 1. : 0.) - projector[col][row]; }
+        }
+        return plane * angle + detail::four_dim_log(rest, plane, complement);
+    }
+
+    // 用给定的随机数引擎生成随机旋量, 种子相同时结果可复现
+    template <typename Generator>
+    ga_type random_rotor(Generator& gen) {
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        std::uniform_real_distribution<double> angle_dist(0.0, 2.0 * std::numbers::pi);
+
+        // 生成随机角度
+        double angle = angle_dist(gen);
+
+        // 生成随机的单位二重向量
+        ga_type bivector{};
+
+        // 在6维空间中，有C(6,2)=15个基二重向量
+        // 我们生成15个随机系数，然后归一化
+        double norm_sq = 0.0;
+        for (size_t i = 0; i < ga_type::kBasesCnt; ++i) {
+            if (std::popcount(i) == 2) {  // 只处理二重向量基
+                double coeff = dist(gen);
+                bivector.data[i] = coeff;
+                norm_sq += coeff * coeff;
+            }
+        }
+
+        // 归一化二重向量
+        if (norm_sq > 1e-10) {
+            double inv_norm = 1.0 / std::sqrt(norm_sq);
+            for (size_t i = 0; i < ga_type::kBasesCnt; ++i) {
+                if (std::popcount(i) == 2) {
+                    bivector.data[i] *= inv_norm;
+                }
+            }
+        } else {
+            // 如果随机数太小，使用默认二重向量
+            bivector.data[0b000011] = 1.0;  // e_{0,1}
+        }
+
+        // 计算旋量：exp(angle/2 * bivector)
+        ga_type rotor = bivector_exp(bivector_type{bivector} * (angle * 0.5)).to_full();
+
+        // 归一化旋量以确保数值稳定性
+        return rotor * (1. / rotor.norm());
+    }
+
+    // 随机旋量, 种子来自random_device
+    inline ga_type random_rotor() {
+        static std::random_device random_device;
+        static std::mt19937 gen(random_device());
+        return random_rotor(gen);
+    }
+
+    inline ga_type rotor_lerp(const ga_type& rotor, double times) {
+        // 从单位旋量插值到rotor: exp(t * log(rotor))
+        const bivector_type log_rotor = rotor_log(rotor_type{rotor});
+        return bivector_exp(log_rotor * times).to_full();
+    }
+
+    inline ga_type rotor_lerp(const ga_type& start, const ga_type& end, double t_val) {
+        t_val = std::clamp(t_val, 0.0, 1.0);
+
+        // 计算相对旋量：end * start^{-1}, 旋量的逆是~start / |start|^2, 反转和缩放并进乘法里
+        const ga_type relative_rotor = ga_expr::lazy(end) * ga_expr::lazy(start).reverse() * (1. / start.norm_squared());
+
+        // 计算相对旋量的对数（得到一个二重向量）
+        const bivector_type log_relative = rotor_log(rotor_type{relative_rotor});
+
+        // 插值：exp(t * log(relative)) * start, t = 1时正好是end
+        ga_type result = bivector_exp(log_relative * t_val).to_full() * start;
+
+        // 归一化结果以确保数值稳定性
+        double norm = result.norm();
+        result = result * (1.0 / norm);
+
+        return result;
+    }
+}  // namespace vga6
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <luisa/luisa-compute.h>
+
+using namespace luisa;
+using namespace luisa::compute;
+
+/* YUV4MPEG2视频流输出: 颜色转换和色度下采样在设备上做, 拷回host的已经是YUV420的平面数据,
+ * host只需要顺序写出, 不需要中间图片文件. 任何编码器都可以直接读, 比如
+ * mandelbrot_6d_animation cuda 1 camera_path.bin y4m - | ffmpeg -i - out.mp4
+ */
+namespace y4m {
+// YUV420一帧的字节数: 亮度W * H, 两个色度平面各(W / 2) * (H / 2)
+[[nodiscard]] constexpr size_t frame_bytes(size_t width, size_t height) { return width * height * 3 / 2; }
+
+// 设备上按uint打包, 每个uint装4个字节(低位在前, 拷回小端的host后就是字节顺序)
+[[nodiscard]] constexpr size_t frame_words(size_t width, size_t height) { return frame_bytes(width, height) / 4; }
+
+namespace detail {
+// BT.601有限范围: Y在[16, 235], U, V在[16, 240], 输入是[0, 1]的RGB
+[[nodiscard]] inline Float luma(const Float3& rgb) {
+    return 16.F + 219.F * dot(rgb, make_float3(.299F, .587F, .114F));
+}
+
+[[nodiscard]] inline Float chroma_u(const Float3& rgb) {
+    return 128.F + 224.F * dot(rgb, make_float3(-.168736F, -.331264F, .5F));
+}
+
+[[nodiscard]] inline Float chroma_v(const Float3& rgb) {
+    return 128.F + 224.F * dot(rgb, make_float3(.5F, -.418688F, -.081312F));
+}
+
+[[nodiscard]] inline UInt to_byte(const Float& val) { return clamp(val + .5F, 0.F, 255.F).cast<uint>(); }
+
+[[nodiscard]] inline UInt pack(const UInt& byte0, const UInt& byte1, const UInt& byte2, const UInt& byte3) {
+    return byte0 | (byte1 << 8u) | (byte2 << 16u) | (byte3 << 24u);
+}
+}  // namespace detail
+
+/* 在kernel里调用, dispatch大小为(W / 8, H / 2), W需要是8的倍数, H是2的倍数
+ * 每个线程读8x2个像素, 写2行各8个Y(4个uint)和各4个U, V(各1个uint). 色度取2x2像素的平均, 即C420jpeg的采样位置
+ */
+inline void convert_block(const ImageFloat& image, const BufferUInt& yuv) {
+    const UInt2 block = dispatch_id().xy();
+    const UInt width = dispatch_size().x * 8u;
+    const UInt height = dispatch_size().y * 2u;
+    const UInt luma_words = width * height / 4u;
+    const UInt chroma_words = luma_words / 4u;
+
+    std::array<std::array<Float3, 8>, 2> rgb;
+    for (uint row = 0; row < 2; ++row) {
+        std::array<UInt, 8> luma_bytes;
+        for (uint col = 0; col < 8; ++col) {
+            rgb[row][col] = image.read(make_uint2(block.x * 8u + col, block.y * 2u + row)).xyz();
+            luma_bytes[col] = detail::to_byte(detail::luma(rgb[row][col]));
+        }
+        const UInt first_word = (block.y * 2u + row) * (width / 4u) + block.x * 2u;
+        yuv.write(first_word, detail::pack(luma_bytes[0], luma_bytes[1], luma_bytes[2], luma_bytes[3]));
+        yuv.write(first_word + 1u, detail::pack(luma_bytes[4], luma_bytes[5], luma_bytes[6], luma_bytes[7]));
+    }
+
+    std::array<UInt, 4> u_bytes;
+    std::array<UInt, 4> v_bytes;
+    for (uint pair = 0; pair < 4; ++pair) {
+        const Float3 average = (rgb[0][pair * 2] + rgb[0][pair * 2 + 1] + rgb[1][pair * 2] + rgb[1][pair * 2 + 1]) * .25F;
+        u_bytes[pair] = detail::to_byte(detail::chroma_u(average));
+        v_bytes[pair] = detail::to_byte(detail::chroma_v(average));
+    }
+    const UInt chroma_word = luma_words + block.y * (width / 8u) + block.x;
+    yuv.write(chroma_word, detail::pack(u_bytes[0], u_bytes[1], u_bytes[2], u_bytes[3]));
+    yuv.write(chroma_word + chroma_words, detail::pack(v_bytes[0], v_bytes[1], v_bytes[2], v_bytes[3]));
+}
+
+// 顺序写出YUV4MPEG2流, 帧数据就是convert_block拷回的字节
+class Writer {
+public:
+    // file为"-"时写到标准输出
+    Writer(const std::string& file, std::uint32_t width, std::uint32_t height, std::uint32_t fps = 60)
+        : frame_size_(frame_bytes(width, height)) {
+        if (file == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            file_ = stdout;
+        } else {
+            file_ = std::fopen(file.c_str(), "wb");
+            owns_file_ = true;
+        }
+        if (file_ != nullptr) {
+            std::fprintf(file_, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+        }
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+        if (file_ == nullptr) { return; }
+        if (owns_file_) {
+            std::fclose(file_);
+        } else {
+            std::fflush(file_);
+        }
+    }
+
+    [[nodiscard]] bool is_open() const { return file_ != nullptr; }
+
+    // 写失败(比如管道另一端已经关闭)时返回false
+    bool write_frame(std::span<const std::byte> yuv) {
+        if (file_ == nullptr || yuv.size() < frame_size_) { return false; }
+        return std::fputs("FRAME\n", file_) >= 0 && std::fwrite(yuv.data(), 1, frame_size_, file_) == frame_size_;
+    }
+
+private:
+    std::FILE* file_ = nullptr;
+    bool owns_file_ = false;
+    size_t frame_size_;
+};
+}  // namespace y4m
@@ -28,3 +28,31 @@ target("main")
         os.vcp(path.join(target:pkg("luisa-compute"):installdir(), "bin/*"), target:targetdir())
     end)
 target_end()
+
+target("ga_bench")
+    set_encodings("utf-8")
+    set_kind("binary")
+
+    add_packages("luisa-compute")
+    add_files("src/ga_bench.cpp")
+    add_vectorexts("avx2", "fma") -- 打开ga_simd.hpp里的向量化乘法
+    if is_plat("linux") then
+        add_syslinks("pthread") -- ga_batch.hpp的多线程
+    end
+target_end()
+
+target("mandelbrot_6d_animation")
+    set_encodings("utf-8")
+    set_kind("binary")
+
+    add_packages("luisa-compute")
+    add_files("src/mandelbrot_6d_animation.cpp")
+    add_vectorexts("avx2", "fma") -- 相机路径预计算里的GeoAlg乘法走ga_simd.hpp的向量化路径
+    if is_plat("linux") then
+        add_syslinks("pthread") -- frame_encoder.hpp的编码线程和ga_batch.hpp的多线程
+    end
+
+    on_config(function (target)
+        os.vcp(path.join(target:pkg("luisa-compute"):installdir(), "bin/*"), target:targetdir())
+    end)
+target_end()